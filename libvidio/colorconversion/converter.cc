@@ -19,12 +19,49 @@
  */
 
 #include "converter.h"
-#include <cassert>
+#include "libvidio/vidio_format_converter.h"
+#include <map>
+#include <memory>
+#include <utility>
 
 #include "yuv2rgb.h"
 #include "mjpeg.h"
 
 
+// Converters that are reused for all frames converted by a thread, keyed by input and output format.
+// Only converters without state between frames are cached (raw formats and MJPEG), because the frames
+// of different streams may be converted by the same thread.
+static thread_local std::map<std::pair<vidio_pixel_format, vidio_pixel_format>,
+                             std::unique_ptr<vidio_format_converter>> t_converters;
+
+
+// Inter-frame codecs keep reference pictures and may delay frames. They need one vidio_format_converter per stream.
+static bool is_inter_frame_codec(vidio_pixel_format format)
+{
+  return format == vidio_pixel_format_H264 || format == vidio_pixel_format_H265;
+}
+
+
+static vidio_frame* convert_with_converter(const vidio_frame* input, vidio_pixel_format format)
+{
+  if (is_inter_frame_codec(input->get_pixel_format())) {
+    return nullptr;
+  }
+
+  auto& converter = t_converters[{input->get_pixel_format(), format}];
+  if (!converter) {
+    converter.reset(vidio_format_converter::create(input->get_pixel_format(), format));
+    if (!converter) {
+      t_converters.erase({input->get_pixel_format(), format});
+      return nullptr;
+    }
+  }
+
+  converter->push(input);
+  return converter->pull();
+}
+
+
 static vidio_frame* convert_to_rgb8(const vidio_frame* input)
 {
   vidio_pixel_format inputFormat = input->get_pixel_format();
@@ -32,11 +69,12 @@ static vidio_frame* convert_to_rgb8(const vidio_frame* input)
   switch (inputFormat) {
     case vidio_pixel_format_YUV422_YUYV:
       return yuyv_to_rgb8(input);
+    case vidio_pixel_format_YUV420_planar:
+      return yuv420_to_rgb8(input);
     case vidio_pixel_format_MJPEG:
       return mjpeg_to_rgb8_ffmpeg(input);
     default:
-      assert(false);
-      return nullptr;
+      return convert_with_converter(input, vidio_pixel_format_RGB8);
   }
 }
 
@@ -47,7 +85,13 @@ vidio_frame* convert_frame(const vidio_frame* input, vidio_pixel_format format)
     case vidio_pixel_format_RGB8:
       return convert_to_rgb8(input);
     default:
-      assert(false);
-      return nullptr;
+      return convert_with_converter(input, format);
   }
 }
+
+
+void release_convert_frame_resources()
+{
+  mjpeg_release_decoder();
+  t_converters.clear();
+}
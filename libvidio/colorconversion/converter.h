@@ -25,4 +25,7 @@
 
 vidio_frame* convert_frame(const vidio_frame* input, vidio_pixel_format format);
 
+// Frees the decoders that convert_frame() keeps for the calling thread.
+void release_convert_frame_resources();
+
 #endif //LIBVIDIO_CONVERTER_H
@@ -20,11 +20,265 @@
 
 #include "ffmpeg.h"
 #include "common.h"
+#include "libvidio/vidio_error.h"
 #include <cassert>
+#include <algorithm>
+#include <string>
 
 extern "C"
 {
 #include <libswscale/swscale.h>
+#include <libavutil/pixdesc.h>
+}
+
+
+void get_avframe_colorimetry(const AVFrame* frame, vidio_color_matrix& out_matrix, vidio_color_range& out_range)
+{
+  switch (frame->colorspace) {
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:
+      out_matrix = vidio_color_matrix_bt601;
+      break;
+    case AVCOL_SPC_BT709:
+      out_matrix = vidio_color_matrix_bt709;
+      break;
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+      out_matrix = vidio_color_matrix_bt2020;
+      break;
+    default:
+      out_matrix = vidio_color_matrix_unknown;
+      break;
+  }
+
+  switch (frame->color_range) {
+    case AVCOL_RANGE_MPEG:
+      out_range = vidio_color_range_limited;
+      break;
+    case AVCOL_RANGE_JPEG:
+      out_range = vidio_color_range_full;
+      break;
+    default:
+      // The deprecated YUVJ formats are full range, even if this is not stated explicitly.
+      switch (frame->format) {
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUVJ444P:
+          out_range = vidio_color_range_full;
+          break;
+        default:
+          out_range = vidio_color_range_unknown;
+          break;
+      }
+      break;
+  }
+}
+
+
+void set_swscale_colorimetry(struct SwsContext* context, vidio_color_matrix matrix, vidio_color_range range,
+                             bool rgb_output)
+{
+  int colorspace;
+  switch (matrix) {
+    case vidio_color_matrix_bt709:
+      colorspace = SWS_CS_ITU709;
+      break;
+    case vidio_color_matrix_bt2020:
+      colorspace = SWS_CS_BT2020;
+      break;
+    default:
+      colorspace = SWS_CS_ITU601;
+      break;
+  }
+
+  const int* coefficients = sws_getCoefficients(colorspace);
+  int src_range = (range == vidio_color_range_full) ? 1 : 0;
+  int dst_range = rgb_output ? 1 : src_range;
+
+  sws_setColorspaceDetails(context, coefficients, src_range, coefficients, dst_range, 0, 1 << 16, 1 << 16);
+}
+
+
+vidio_sliced_swscale::~vidio_sliced_swscale()
+{
+  free_contexts();
+}
+
+
+void vidio_sliced_swscale::free_contexts()
+{
+  for (auto* context : m_contexts) {
+    sws_freeContext(context);
+  }
+
+  m_contexts.clear();
+}
+
+
+bool vidio_sliced_swscale::init(int w, int h, AVPixelFormat input_format, AVPixelFormat output_format, int num_slices,
+                                vidio_color_matrix matrix, vidio_color_range range, bool rgb_output)
+{
+  if (!m_contexts.empty() &&
+      w == m_width && h == m_height &&
+      input_format == m_input_format && output_format == m_output_format &&
+      num_slices == m_num_slices) {
+
+    // Frames of the same stream can change their colorimetry, or it can be overridden with vidio_frame_set_colorimetry().
+    if (matrix != m_color_matrix || range != m_color_range || rgb_output != m_rgb_output) {
+      m_color_matrix = matrix;
+      m_color_range = range;
+      m_rgb_output = rgb_output;
+
+      for (auto* context : m_contexts) {
+        set_swscale_colorimetry(context, matrix, range, rgb_output);
+      }
+    }
+
+    return true;
+  }
+
+  free_contexts();
+
+  m_width = w;
+  m_height = h;
+  m_input_format = input_format;
+  m_output_format = output_format;
+  m_num_slices = num_slices;
+  m_color_matrix = matrix;
+  m_color_range = range;
+  m_rgb_output = rgb_output;
+
+  // Slices have to start at a row that has its own chroma samples.
+  int alignment = 1 << std::max(av_pix_fmt_desc_get(input_format)->log2_chroma_h,
+                                av_pix_fmt_desc_get(output_format)->log2_chroma_h);
+
+  m_slices = split_into_row_slices(h, num_slices, alignment);
+
+  for (const auto& slice : m_slices) {
+    SwsContext* context = sws_getContext(w, slice.num_rows(), input_format,
+                                         w, slice.num_rows(), output_format,
+                                         SWS_FAST_BILINEAR, NULL, NULL, NULL);
+    if (!context) {
+      free_contexts();
+      return false;
+    }
+
+    set_swscale_colorimetry(context, matrix, range, rgb_output);
+    m_contexts.push_back(context);
+  }
+
+  return true;
+}
+
+
+// Moves the plane pointers to the first row of a slice.
+static void offset_planes(AVPixelFormat format, int first_row, const uint8_t* const planes[], const int stride[],
+                          const uint8_t* out_planes[4])
+{
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+  int num_planes = av_pix_fmt_count_planes(format);
+
+  for (int p = 0; p < 4; p++) {
+    if (p < num_planes) {
+      // Planes 1 and 2 are chroma, plane 3 is alpha.
+      int row = (p == 1 || p == 2) ? (first_row >> desc->log2_chroma_h) : first_row;
+      out_planes[p] = planes[p] + row * stride[p];
+    }
+    else {
+      out_planes[p] = nullptr;
+    }
+  }
+}
+
+
+void vidio_sliced_swscale::scale(const uint8_t* const src[], const int src_stride[],
+                                 uint8_t* const dst[], const int dst_stride[])
+{
+  vidio_thread_pool::get_instance().parallel_for((int) m_slices.size(), (int) m_slices.size(), [&](int i) {
+    const vidio_row_slice& slice = m_slices[i];
+
+    const uint8_t* slice_src[4];
+    const uint8_t* slice_dst[4];
+    offset_planes(m_input_format, slice.first_row, src, src_stride, slice_src);
+    offset_planes(m_output_format, slice.first_row, dst, dst_stride, slice_dst);
+
+    sws_scale(m_contexts[i], slice_src, src_stride, 0, slice.num_rows(),
+              const_cast<uint8_t* const*>(slice_dst), dst_stride);
+  });
+}
+
+
+// Memory layout of the raw vidio pixel formats, with the planes in the order that swscale expects.
+struct raw_format_layout
+{
+  vidio_pixel_format format;
+  AVPixelFormat av_format;
+  int num_planes;
+  vidio_color_channel channels[3];
+  int bpp[3];
+  bool is_yuv;
+};
+
+static const raw_format_layout s_raw_format_layouts[] = {
+    {vidio_pixel_format_RGB8,          AV_PIX_FMT_RGB24,       1, {vidio_color_channel_interleaved}, {24}, false},
+    {vidio_pixel_format_RGB8_planar,   AV_PIX_FMT_GBRP,        3, {vidio_color_channel_G, vidio_color_channel_B, vidio_color_channel_R}, {8, 8, 8}, false},
+    {vidio_pixel_format_BGR8,          AV_PIX_FMT_BGR24,       1, {vidio_color_channel_interleaved}, {24}, false},
+    {vidio_pixel_format_RGBA8,         AV_PIX_FMT_RGBA,        1, {vidio_color_channel_interleaved}, {32}, false},
+    {vidio_pixel_format_BGRA8,         AV_PIX_FMT_BGRA,        1, {vidio_color_channel_interleaved}, {32}, false},
+    {vidio_pixel_format_YUV420_planar, AV_PIX_FMT_YUV420P,     3, {vidio_color_channel_Y, vidio_color_channel_U, vidio_color_channel_V}, {8, 8, 8}, true},
+    {vidio_pixel_format_YUV422_YUYV,   AV_PIX_FMT_YUYV422,     1, {vidio_color_channel_interleaved}, {16}, true},
+    {vidio_pixel_format_YUV420_NV12,   AV_PIX_FMT_NV12,        2, {vidio_color_channel_Y, vidio_color_channel_UV}, {8, 16}, true},
+    {vidio_pixel_format_YUV422_NV16,   AV_PIX_FMT_NV16,        2, {vidio_color_channel_Y, vidio_color_channel_UV}, {8, 16}, true},
+    {vidio_pixel_format_YUV420_NV21,   AV_PIX_FMT_NV21,        2, {vidio_color_channel_Y, vidio_color_channel_UV}, {8, 16}, true},
+    {vidio_pixel_format_YUV422_UYVY,   AV_PIX_FMT_UYVY422,     1, {vidio_color_channel_interleaved}, {16}, true},
+    {vidio_pixel_format_GREY8,         AV_PIX_FMT_GRAY8,       1, {vidio_color_channel_Y}, {8}, false},
+    {vidio_pixel_format_RGGB8,         AV_PIX_FMT_BAYER_RGGB8, 1, {vidio_color_channel_interleaved}, {8}, false}
+};
+
+
+static const raw_format_layout* get_raw_format_layout(vidio_pixel_format format)
+{
+  for (const auto& layout : s_raw_format_layouts) {
+    if (layout.format == format) {
+      return &layout;
+    }
+  }
+
+  return nullptr;
+}
+
+
+// swscale can read Bayer images, but not write them.
+static bool is_supported_output_format(vidio_pixel_format format)
+{
+  return get_raw_format_layout(format) != nullptr && format != vidio_pixel_format_RGGB8;
+}
+
+
+static bool is_rgb_format(vidio_pixel_format format)
+{
+  const raw_format_layout* layout = get_raw_format_layout(format);
+  return layout && !layout->is_yuv && layout->format != vidio_pixel_format_GREY8;
+}
+
+
+static vidio_frame* create_output_frame(const raw_format_layout& layout, int w, int h,
+                                        uint8_t* out_data[4], int out_stride[4])
+{
+  auto* frame = new vidio_frame();
+  frame->set_format(layout.format, w, h);
+
+  for (int p = 0; p < 4; p++) {
+    out_data[p] = nullptr;
+    out_stride[p] = 0;
+  }
+
+  for (int p = 0; p < layout.num_planes; p++) {
+    frame->add_raw_plane(layout.channels[p], layout.bpp[p]);
+    out_data[p] = frame->get_plane(layout.channels[p], &out_stride[p]);
+  }
+
+  return frame;
 }
 
 
@@ -33,40 +287,40 @@ vidio_format_converter_ffmpeg::~vidio_format_converter_ffmpeg()
   avcodec_free_context(&m_context);
   av_frame_free(&m_decodedFrame);
   //av_packet_free(&m_pkt);
-  sws_freeContext(m_swscaleContext);
 }
 
 
 vidio_error* vidio_format_converter_ffmpeg::init(enum AVCodecID codecId, vidio_pixel_format output_format)
 {
-  if (output_format != vidio_pixel_format_RGB8 &&
-      output_format != vidio_pixel_format_YUV422_YUYV) {
-    return nullptr;
+  if (!is_supported_output_format(output_format)) {
+    auto* err = new vidio_error(vidio_error_code_parameter_error, "Cannot decode into pixel format {0}");
+    err->set_arg(0, std::to_string(output_format));
+    return err;
   }
 
   // AVCodec
 
   m_codec = avcodec_find_decoder(codecId);
   if (!m_codec) {
-    return nullptr;
+    return new vidio_error(vidio_error_code_internal_error, "FFmpeg has no decoder for this codec");
   }
 
   // AVContext
 
   m_context = avcodec_alloc_context3(m_codec);
   if (!m_context) {
-    return nullptr; //Error
+    return new vidio_error(vidio_error_code_internal_error, "Cannot allocate FFmpeg decoder context");
   }
 
   if (avcodec_open2(m_context, m_codec, nullptr) < 0) {
-    return nullptr;
+    return new vidio_error(vidio_error_code_internal_error, "Cannot open FFmpeg decoder");
   }
 
   // AVFrame
 
   m_decodedFrame = av_frame_alloc();
   if (!m_decodedFrame) {
-    return nullptr;
+    return new vidio_error(vidio_error_code_internal_error, "Cannot allocate FFmpeg frame");
   }
 
   m_output_format = output_format;
@@ -90,14 +344,16 @@ void vidio_format_converter_ffmpeg::push(const vidio_frame* input)
 
   int res = av_new_packet(pkt, in_stride);
   if (res != 0) {
+    av_packet_free(&pkt);
     return;
   }
 
   memcpy(pkt->data, in, in_stride);
 
-  // decode frame
+  // decode frame (the decoder keeps its own reference to the packet data)
 
   res = avcodec_send_packet(m_context, pkt);
+  av_packet_free(&pkt);
   if (res != 0) {
     return;
   }
@@ -107,14 +363,23 @@ void vidio_format_converter_ffmpeg::push(const vidio_frame* input)
     return;
   }
 
-  av_packet_free(&pkt);
-
   // convert to vidio_frame
 
   vidio_frame* out_frame = convert_avframe_to_vidio_frame(m_context->pix_fmt, m_decodedFrame,
                                                           m_output_format);
+  if (!out_frame) {
+    return;
+  }
 
   out_frame->copy_metadata_from(input);
+
+  // The compressed input has no colorimetry, but the decoder knows it from the bitstream.
+  vidio_color_matrix matrix;
+  vidio_color_range range;
+  get_avframe_colorimetry(m_decodedFrame, matrix, range);
+  if (matrix != vidio_color_matrix_unknown || range != vidio_color_range_unknown) {
+    out_frame->set_colorimetry(matrix, range);
+  }
   push_decoded_frame(out_frame);
 }
 
@@ -126,42 +391,27 @@ vidio_frame* vidio_format_converter_ffmpeg::convert_avframe_to_vidio_frame(AVPix
   int w = input->width;
   int h = input->height;
 
-  AVPixelFormat output_av_format = AV_PIX_FMT_NONE;
-
-  vidio_frame* out_frame = new vidio_frame();
-  out_frame->set_format(output_format, w, h);
+  const raw_format_layout* out_layout = get_raw_format_layout(output_format);
+  assert(out_layout);
 
-  uint8_t* out_data[3];
-  int out_stride[3];
-
-  switch (output_format) {
-    case vidio_pixel_format_RGB8:
-      output_av_format = AV_PIX_FMT_RGB24;
-      out_frame->add_raw_plane(vidio_color_channel_interleaved, w, h, 24);
-      out_data[0] = out_frame->get_plane(vidio_color_channel_interleaved, &out_stride[0]);
-      break;
-    case vidio_pixel_format_YUV422_YUYV:
-      output_av_format = AV_PIX_FMT_YUYV422;
-      out_frame->add_raw_plane(vidio_color_channel_interleaved, w, h, 16);
-      out_data[0] = out_frame->get_plane(vidio_color_channel_interleaved, &out_stride[0]);
-      break;
-    default:
-      printf("output format assert: %d\n", output_format);
-      assert(false);
-      break;
-  }
+  uint8_t* out_data[4];
+  int out_stride[4];
+  vidio_frame* out_frame = create_output_frame(*out_layout, w, h, out_data, out_stride);
 
   // SWScale conversion
 
-  if (m_swscaleContext == nullptr) {
-    m_swscaleContext = sws_getContext(w, h, m_context->pix_fmt,
-                                      w, h, output_av_format,
-                                      SWS_FAST_BILINEAR, NULL, NULL, NULL);
+  vidio_color_matrix matrix;
+  vidio_color_range range;
+  get_avframe_colorimetry(m_decodedFrame, matrix, range);
+
+  int num_threads = vidio_thread_pool::get_effective_num_threads(m_num_threads);
+  if (!m_swscale.init(w, h, m_context->pix_fmt, out_layout->av_format, num_threads,
+                      matrix, range, is_rgb_format(output_format))) {
+    delete out_frame;
+    return nullptr;
   }
 
-  sws_scale(m_swscaleContext, m_decodedFrame->data, m_decodedFrame->linesize,
-            0, h,
-            out_data, out_stride);
+  m_swscale.scale(m_decodedFrame->data, m_decodedFrame->linesize, out_data, out_stride);
 
   return out_frame;
 }
@@ -172,80 +422,59 @@ vidio_format_converter_swscale::vidio_format_converter_swscale(vidio_pixel_forma
   m_output_format = output_format;
 }
 
-vidio_format_converter_swscale::~vidio_format_converter_swscale()
+vidio_format_converter_swscale::~vidio_format_converter_swscale() = default;
+
+bool vidio_format_converter_swscale::supports(vidio_pixel_format input_format, vidio_pixel_format output_format)
 {
-  sws_freeContext(m_swscaleContext);
+  return get_raw_format_layout(input_format) != nullptr && is_supported_output_format(output_format);
 }
 
+
 void vidio_format_converter_swscale::push(const vidio_frame* in_frame)
 {
   int w = in_frame->get_width();
   int h = in_frame->get_height();
 
-  AVPixelFormat input_av_format = AV_PIX_FMT_NONE;
-  AVPixelFormat output_av_format = AV_PIX_FMT_NONE;
+  const raw_format_layout* in_layout = get_raw_format_layout(in_frame->get_pixel_format());
+  const raw_format_layout* out_layout = get_raw_format_layout(m_output_format);
+  if (!in_layout || !out_layout) {
+    return;
+  }
 
-  const uint8_t* in_data[3];
-  int in_stride[3];
+  const uint8_t* in_data[4]{};
+  int in_stride[4]{};
 
-  switch (in_frame->get_pixel_format()) {
-    case vidio_pixel_format_RGB8:
-      input_av_format = AV_PIX_FMT_RGB24;
-      in_data[0] = in_frame->get_plane(vidio_color_channel_interleaved, &in_stride[0]);
-      break;
-    case vidio_pixel_format_YUV422_YUYV:
-      input_av_format = AV_PIX_FMT_YUYV422;
-      in_data[0] = in_frame->get_plane(vidio_color_channel_interleaved, &in_stride[0]);
-      break;
-    case vidio_pixel_format_RGGB8:
-      input_av_format = AV_PIX_FMT_BAYER_RGGB8;
-      in_data[0] = in_frame->get_plane(vidio_color_channel_interleaved, &in_stride[0]);
-      break;
-    default:
-      assert(false);
-      break;
+  for (int p = 0; p < in_layout->num_planes; p++) {
+    in_data[p] = in_frame->get_plane(in_layout->channels[p], &in_stride[p]);
+    if (!in_data[p]) {
+      return;
+    }
   }
 
+  AVPixelFormat input_av_format = in_layout->av_format;
+  bool yuv_input = in_layout->is_yuv;
 
-  vidio_frame* out_frame = new vidio_frame();
-  out_frame->set_format(m_output_format, w, h);
+  uint8_t* out_data[4];
+  int out_stride[4];
+  vidio_frame* out_frame = create_output_frame(*out_layout, w, h, out_data, out_stride);
 
-  uint8_t* out_data[3];
-  int out_stride[3];
+  // SWScale conversion
 
-  switch (m_output_format) {
-    case vidio_pixel_format_RGB8:
-      output_av_format = AV_PIX_FMT_RGB24;
-      out_frame->add_raw_plane(vidio_color_channel_interleaved, w, h, 24);
-      out_data[0] = out_frame->get_plane(vidio_color_channel_interleaved, &out_stride[0]);
-      break;
-    case vidio_pixel_format_YUV422_YUYV:
-      output_av_format = AV_PIX_FMT_YUYV422;
-      out_frame->add_raw_plane(vidio_color_channel_interleaved, w, h, 16);
-      out_data[0] = out_frame->get_plane(vidio_color_channel_interleaved, &out_stride[0]);
-      break;
-    case vidio_pixel_format_RGGB8:
-      output_av_format = AV_PIX_FMT_BAYER_RGGB8;
-      out_frame->add_raw_plane(vidio_color_channel_interleaved, w, h, 8);
-      out_data[0] = out_frame->get_plane(vidio_color_channel_interleaved, &out_stride[0]);
-      break;
-    default:
-      assert(false);
-      break;
-  }
+  // Demosaicing needs the neighbouring rows, Bayer input is not split into slices.
+  int num_threads = vidio_thread_pool::get_effective_num_threads(m_num_threads);
+  int num_slices = (input_av_format == AV_PIX_FMT_BAYER_RGGB8) ? 1 : num_threads;
 
-  // SWScale conversion
+  // The colorimetry of RGB input is not used by swscale. Use the default, it is not known anyway.
+  vidio_color_matrix matrix = yuv_input ? in_frame->get_color_matrix() : vidio_color_matrix_unknown;
+  vidio_color_range range = yuv_input ? in_frame->get_color_range() : vidio_color_range_unknown;
 
-  if (m_swscaleContext == nullptr) {
-    m_swscaleContext = sws_getContext(w, h, input_av_format,
-                                      w, h, output_av_format,
-                                      SWS_FAST_BILINEAR, NULL, NULL, NULL);
+  if (!m_swscale.init(w, h, input_av_format, out_layout->av_format, num_slices,
+                      matrix, range, is_rgb_format(m_output_format))) {
+    delete out_frame;
+    return;
   }
 
-  sws_scale(m_swscaleContext,
-            in_data, in_stride,
-            0, h,
-            out_data, out_stride);
+  m_swscale.scale(in_data, in_stride, out_data, out_stride);
 
   out_frame->copy_metadata_from(in_frame);
   push_decoded_frame(out_frame);
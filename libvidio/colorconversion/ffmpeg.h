@@ -22,12 +22,56 @@
 #define LIBVIDIO_FFMPEG_H
 
 #include "libvidio/vidio_format_converter.h"
+#include "libvidio/util/thread_pool.h"
+#include <vector>
 
 extern "C"
 {
 #include <libavcodec/avcodec.h>
 }
 
+struct SwsContext;
+
+
+// Colorimetry of a decoded frame. Values that are not specified in the stream are returned as unknown.
+void get_avframe_colorimetry(const AVFrame* frame, vidio_color_matrix& out_matrix, vidio_color_range& out_range);
+
+// Makes swscale convert from the given YUV matrix and range. For YUV output formats, the range is kept.
+void set_swscale_colorimetry(struct SwsContext* context, vidio_color_matrix matrix, vidio_color_range range,
+                             bool rgb_output);
+
+
+// swscale conversion that is split into horizontal slices. Each slice has its own SwsContext, such that the
+// slices can be converted in parallel.
+class vidio_sliced_swscale
+{
+public:
+  ~vidio_sliced_swscale();
+
+  // (Re)creates the contexts when the formats, the size or the number of slices have changed.
+  // A changed colorimetry is applied to the existing contexts.
+  bool init(int w, int h, AVPixelFormat input_format, AVPixelFormat output_format, int num_slices,
+            vidio_color_matrix matrix, vidio_color_range range, bool rgb_output);
+
+  void scale(const uint8_t* const src[], const int src_stride[],
+             uint8_t* const dst[], const int dst_stride[]);
+
+private:
+  std::vector<struct SwsContext*> m_contexts;
+  std::vector<vidio_row_slice> m_slices;
+
+  int m_width = 0, m_height = 0;
+  AVPixelFormat m_input_format = AV_PIX_FMT_NONE;
+  AVPixelFormat m_output_format = AV_PIX_FMT_NONE;
+  int m_num_slices = 0;
+
+  vidio_color_matrix m_color_matrix = vidio_color_matrix_unknown;
+  vidio_color_range m_color_range = vidio_color_range_unknown;
+  bool m_rgb_output = false;
+
+  void free_contexts();
+};
+
 
 struct vidio_format_converter_ffmpeg : public vidio_format_converter
 {
@@ -47,7 +91,7 @@ private:
 
   vidio_frame* convert_avframe_to_vidio_frame(AVPixelFormat input_format, AVFrame* input, vidio_pixel_format output_format);
 
-  struct SwsContext* m_swscaleContext = nullptr;
+  vidio_sliced_swscale m_swscale;
 };
 
 
@@ -56,6 +100,9 @@ struct vidio_format_converter_swscale : public vidio_format_converter
 public:
   vidio_format_converter_swscale(vidio_pixel_format output_format);
 
+  // All raw pixel formats can be converted into each other, except that Bayer images can only be input.
+  static bool supports(vidio_pixel_format input_format, vidio_pixel_format output_format);
+
   ~vidio_format_converter_swscale() override;
 
   void push(const vidio_frame* in) override;
@@ -63,7 +110,7 @@ public:
 private:
   vidio_pixel_format m_output_format = vidio_pixel_format_undefined;
 
-  struct SwsContext* m_swscaleContext = nullptr;
+  vidio_sliced_swscale m_swscale;
 };
 
 
@@ -20,9 +20,13 @@
 
 #include "mjpeg.h"
 #include "common.h"
+#include "yuv2rgb.h"
+#include "ffmpeg.h"
 #include "libvidio/vidio_frame.h"
 #include "libvidio/third-party/jpeg_decoder.h"
 #include <cassert>
+#include <algorithm>
+#include <memory>
 
 extern "C"
 {
@@ -70,85 +74,188 @@ vidio_frame* mjpeg_to_rgb8_small(const vidio_frame* input)
 }
 
 
-vidio_frame* mjpeg_to_rgb8_ffmpeg(const vidio_frame* input)
+// Decoder state that is reused for all frames converted by a thread. Opening the decoder takes longer than
+// decoding a small frame.
+struct mjpeg_decoder
 {
-  int w = input->get_width();
-  int h = input->get_height();
-
-  vidio_frame* out_frame = new vidio_frame();
-  out_frame->set_format(vidio_pixel_format_RGB8, w, h);
-  out_frame->add_raw_plane(vidio_color_channel_interleaved, w, h, 24);
+  AVCodecContext* context = nullptr;
+  AVPacket* packet = nullptr;
+  AVFrame* frame = nullptr;
+
+  // For decoder output formats that the YUV kernels do not handle (e.g. 4:4:0 or 4:1:1).
+  vidio_sliced_swscale swscale;
+
+  ~mjpeg_decoder()
+  {
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&context);
+  }
 
-  const uint8_t* in;
-  int in_stride;
-  in = input->get_plane(vidio_color_channel_compressed, &in_stride);
+  bool init()
+  {
+    const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+    if (!codec) {
+      return false;
+    }
 
-  uint8_t* out;
-  int out_stride;
-  out = out_frame->get_plane(vidio_color_channel_interleaved, &out_stride);
+    context = avcodec_alloc_context3(codec);
+    if (!context) {
+      return false;
+    }
 
+    if (avcodec_open2(context, codec, nullptr) < 0) {
+      return false;
+    }
 
-  // AVCodec
+    packet = av_packet_alloc();
+    frame = av_frame_alloc();
 
-  const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
-  if (!codec) {
-    return nullptr;
+    return packet && frame;
   }
+};
 
-  // AVContext
+static thread_local std::unique_ptr<mjpeg_decoder> t_mjpeg_decoder;
 
-  AVCodecContext* codecCtx = avcodec_alloc_context3(codec);
-  if (!codecCtx) {
-    return nullptr; //Error
-  }
 
-  if (avcodec_open2(codecCtx, codec, nullptr) < 0) {
-    avcodec_free_context(&codecCtx);
-    return nullptr;
+static mjpeg_decoder* get_mjpeg_decoder()
+{
+  if (!t_mjpeg_decoder) {
+    auto decoder = std::make_unique<mjpeg_decoder>();
+    if (!decoder->init()) {
+      return nullptr;
+    }
+
+    t_mjpeg_decoder = std::move(decoder);
   }
 
-  // AVPacket
+  return t_mjpeg_decoder.get();
+}
 
-  AVPacket* pkt = av_packet_alloc();
-  if (!pkt) {
-    avcodec_free_context(&codecCtx);
-    return nullptr;
-  }
 
-  int res = av_new_packet(pkt, in_stride);
-  if (res != 0) {
+void mjpeg_release_decoder()
+{
+  t_mjpeg_decoder.reset();
+}
+
+
+vidio_frame* mjpeg_to_rgb8_ffmpeg(const vidio_frame* input)
+{
+  int w = input->get_width();
+  int h = input->get_height();
+
+  const uint8_t* in;
+  int in_stride;
+  in = input->get_plane(vidio_color_channel_compressed, &in_stride);
+
+  mjpeg_decoder* decoder = get_mjpeg_decoder();
+  if (!decoder) {
     return nullptr;
   }
 
-  memcpy(pkt->data, in, in_stride);
+  // decode frame
 
-  // AVFrame
+  // The packet does not own the data. avcodec_send_packet() copies it into a padded buffer.
+  AVPacket* pkt = decoder->packet;
+  pkt->data = const_cast<uint8_t*>(in);
+  pkt->size = in_stride;
 
-  AVFrame* decodedFrame = av_frame_alloc();
-  if (!decodedFrame) {
-    avcodec_free_context(&codecCtx);
+  int res = avcodec_send_packet(decoder->context, pkt);
+  av_packet_unref(pkt);
+  if (res < 0) {
+    avcodec_flush_buffers(decoder->context);
     return nullptr;
   }
 
-  // decode frame
+  AVFrame* decodedFrame = decoder->frame;
+  res = avcodec_receive_frame(decoder->context, decodedFrame);
+  if (res < 0) {
+    avcodec_flush_buffers(decoder->context);
+    return nullptr;
+  }
 
-  res = avcodec_send_packet(codecCtx, pkt);
-  res = avcodec_receive_frame(codecCtx, decodedFrame);
+  // Do not write beyond the decoded image if the JPEG is smaller than announced.
+  w = std::min(w, decodedFrame->width);
+  h = std::min(h, decodedFrame->height);
+
+  vidio_frame* out_frame = new vidio_frame();
+  out_frame->set_format(vidio_pixel_format_RGB8, w, h);
+  out_frame->add_raw_plane(vidio_color_channel_interleaved, w, h, 24);
 
-  av_packet_free(&pkt);
+  uint8_t* out;
+  int out_stride;
+  out = out_frame->get_plane(vidio_color_channel_interleaved, &out_stride);
 
   // convert to vidio_frame
 
-  for (int y = 0; y < h; y++)
-    for (int x = 0; x < w; x++) {
-      int yy = decodedFrame->data[0][y * decodedFrame->linesize[0] + x] - 16;
-      int u = decodedFrame->data[1][y * decodedFrame->linesize[1] + x / 2] - 128;
-      int v = decodedFrame->data[2][y * decodedFrame->linesize[2] + x / 2] - 128;
+  const uint8_t* in_y = decodedFrame->data[0];
+  const uint8_t* in_u = decodedFrame->data[1];
+  const uint8_t* in_v = decodedFrame->data[2];
+  const int* linesize = decodedFrame->linesize;
+
+  // Colorimetry from the JPEG stream (usually BT.601, full range), otherwise as reported by the camera.
+  vidio_color_matrix matrix;
+  vidio_color_range range;
+  get_avframe_colorimetry(decodedFrame, matrix, range);
+  if (matrix == vidio_color_matrix_unknown) {
+    matrix = input->get_color_matrix();
+  }
+  if (range == vidio_color_range_unknown) {
+    range = input->get_color_range();
+  }
 
-      out[y * out_stride + 3 * x + 0] = clip8(1.164 * yy + 1.1596 * v);
-      out[y * out_stride + 3 * x + 1] = clip8(1.164 * yy - 0.392 * u - 0.813 * v);
-      out[y * out_stride + 3 * x + 2] = clip8(1.164 * yy + 2.017 * u);
+  const auto& coeffs = get_yuv2rgb_coefficients(matrix, range);
+
+  switch (decodedFrame->format) {
+    case AV_PIX_FMT_YUVJ420P:
+    case AV_PIX_FMT_YUV420P:
+      for (int y = 0; y < h; y++) {
+        yuv_planar_row_to_rgb8(in_y + y * linesize[0], in_u + (y / 2) * linesize[1], in_v + (y / 2) * linesize[2],
+                               out + y * out_stride, w, coeffs);
+      }
+      break;
+
+    case AV_PIX_FMT_YUVJ444P:
+    case AV_PIX_FMT_YUV444P:
+      for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++) {
+          yuv_pixel_to_rgb8(in_y[y * linesize[0] + x], in_u[y * linesize[1] + x], in_v[y * linesize[2] + x],
+                            out + y * out_stride + 3 * x, coeffs);
+        }
+      break;
+
+    case AV_PIX_FMT_YUVJ422P:
+    case AV_PIX_FMT_YUV422P: // the usual MJPEG format of webcams
+      for (int y = 0; y < h; y++) {
+        yuv_planar_row_to_rgb8(in_y + y * linesize[0], in_u + y * linesize[1], in_v + y * linesize[2],
+                               out + y * out_stride, w, coeffs);
+      }
+      break;
+
+    case AV_PIX_FMT_GRAY8:
+      // Grayscale JPEG. There are no chroma planes.
+      for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++) {
+          yuv_pixel_to_rgb8(in_y[y * linesize[0] + x], 128, 128, out + y * out_stride + 3 * x, coeffs);
+        }
+      break;
+
+    default: {
+      auto format = (AVPixelFormat) decodedFrame->format;
+      if (!decoder->swscale.init(w, h, format, AV_PIX_FMT_RGB24, 1, matrix, range, true)) {
+        av_frame_unref(decodedFrame);
+        delete out_frame;
+        return nullptr;
+      }
+
+      uint8_t* dst[1] = {out};
+      int dst_stride[1] = {out_stride};
+      decoder->swscale.scale(decodedFrame->data, decodedFrame->linesize, dst, dst_stride);
+      break;
     }
+  }
+
+  av_frame_unref(decodedFrame);
 
   out_frame->copy_metadata_from(input);
   return out_frame;
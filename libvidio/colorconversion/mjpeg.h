@@ -25,6 +25,10 @@ class vidio_frame;
 
 vidio_frame* mjpeg_to_rgb8_small(const vidio_frame* input);
 
+// The FFmpeg decoder is kept open for the next frame of the calling thread.
 vidio_frame* mjpeg_to_rgb8_ffmpeg(const vidio_frame* input);
 
+// Closes the decoder of the calling thread. It is also closed when the thread ends.
+void mjpeg_release_decoder();
+
 #endif //LIBVIDIO_MJPEG_H
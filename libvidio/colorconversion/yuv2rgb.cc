@@ -19,11 +19,511 @@
  */
 
 #include "yuv2rgb.h"
-#include "common.h"
 #include "libvidio/vidio_frame.h"
+#include "libvidio/util/thread_pool.h"
+#include <cstring>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define VIDIO_YUV2RGB_X86 1
+#include <immintrin.h>
+#endif
 
-vidio_frame* yuyv_to_rgb8(const vidio_frame* input)
+#if defined(__ARM_NEON)
+#define VIDIO_YUV2RGB_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+// Computed from Kr, Kb of each matrix, scaled by 256. Limited range additionally scales Y by 255/219 and
+// the chroma by 255/224 (e.g. 1.164, 1.596, -0.392, -0.813, 2.017 for BT.601).
+static const yuv2rgb_coefficients s_yuv2rgb_coefficients[3][2]{
+    // limited range                   full range
+    {{298, 409, -100, -208, 516, 16}, {256, 359, -88, -183, 454, 0}},  // BT.601
+    {{298, 459, -55, -136, 541, 16},  {256, 403, -48, -120, 475, 0}},  // BT.709
+    {{298, 430, -48, -167, 548, 16},  {256, 377, -42, -146, 482, 0}}   // BT.2020
+};
+
+
+const yuv2rgb_coefficients& get_yuv2rgb_coefficients(vidio_color_matrix matrix, vidio_color_range range)
+{
+  int m;
+  switch (matrix) {
+    case vidio_color_matrix_bt709:
+      m = 1;
+      break;
+    case vidio_color_matrix_bt2020:
+      m = 2;
+      break;
+    default:
+      m = 0;
+      break;
+  }
+
+  return s_yuv2rgb_coefficients[m][range == vidio_color_range_full ? 1 : 0];
+}
+
+
+// --- scalar reference
+
+// Converts the complete pixel pairs of the row.
+static void yuyv_row_to_rgb8_scalar(const uint8_t* in, uint8_t* out, int width, const yuv2rgb_coefficients& c)
+{
+  for (int x = 0; x + 1 < width; x += 2) {
+    yuv_pixel_to_rgb8(in[2 * x + 0], in[2 * x + 1], in[2 * x + 3], out + 3 * x, c);
+    yuv_pixel_to_rgb8(in[2 * x + 2], in[2 * x + 1], in[2 * x + 3], out + 3 * x + 3, c);
+  }
+}
+
+
+static void yuv_planar_row_to_rgb8_scalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* out, int width,
+                                          const yuv2rgb_coefficients& c)
+{
+  for (int x = 0; x < width; x++) {
+    yuv_pixel_to_rgb8(y[x], u[x / 2], v[x / 2], out + 3 * x, c);
+  }
+}
+
+
+#if VIDIO_YUV2RGB_X86
+
+// --- SSE2, 16 pixels per iteration
+
+static inline __m128i coeff_pair_sse2(int16_t a, int16_t b)
+{
+  return _mm_set1_epi32((int) (uint16_t) a | ((int) (uint16_t) b << 16));
+}
+
+
+// Input: 8 pixels of (Y - y_offset), (U - 128), (V - 128) as int16. Output: R, G, B as int16 (not clipped yet).
+static inline void yuv2rgb8_sse2(__m128i c, __m128i d, __m128i e, const yuv2rgb_coefficients& k,
+                                 __m128i& r, __m128i& g, __m128i& b)
+{
+  const __m128i y_vr = coeff_pair_sse2(k.y, k.v_r);
+  const __m128i y_ug = coeff_pair_sse2(k.y, k.u_g);
+  const __m128i y_ub = coeff_pair_sse2(k.y, k.u_b);
+  const __m128i vg_0 = coeff_pair_sse2(k.v_g, 0);
+  const __m128i round = _mm_set1_epi32(128);
+
+  __m128i ce_lo = _mm_unpacklo_epi16(c, e);
+  __m128i ce_hi = _mm_unpackhi_epi16(c, e);
+  __m128i cd_lo = _mm_unpacklo_epi16(c, d);
+  __m128i cd_hi = _mm_unpackhi_epi16(c, d);
+  __m128i e_lo = _mm_unpacklo_epi16(e, _mm_setzero_si128());
+  __m128i e_hi = _mm_unpackhi_epi16(e, _mm_setzero_si128());
+
+  __m128i r_lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ce_lo, y_vr), round), 8);
+  __m128i r_hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ce_hi, y_vr), round), 8);
+
+  __m128i g_lo = _mm_add_epi32(_mm_madd_epi16(cd_lo, y_ug), _mm_madd_epi16(e_lo, vg_0));
+  __m128i g_hi = _mm_add_epi32(_mm_madd_epi16(cd_hi, y_ug), _mm_madd_epi16(e_hi, vg_0));
+  g_lo = _mm_srai_epi32(_mm_add_epi32(g_lo, round), 8);
+  g_hi = _mm_srai_epi32(_mm_add_epi32(g_hi, round), 8);
+
+  __m128i b_lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd_lo, y_ub), round), 8);
+  __m128i b_hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd_hi, y_ub), round), 8);
+
+  r = _mm_packs_epi32(r_lo, r_hi);
+  g = _mm_packs_epi32(g_lo, g_hi);
+  b = _mm_packs_epi32(b_lo, b_hi);
+}
+
+
+// Splits 8 YUYV pixels into (Y - y_offset) and the chroma values replicated to both pixels of each pair.
+static inline void load_yuyv8_sse2(const uint8_t* in, const yuv2rgb_coefficients& k,
+                                   __m128i& c, __m128i& d, __m128i& e)
+{
+  __m128i a = _mm_loadu_si128((const __m128i*) in);
+  __m128i uv = _mm_sub_epi16(_mm_srli_epi16(a, 8), _mm_set1_epi16(128));
+
+  c = _mm_sub_epi16(_mm_and_si128(a, _mm_set1_epi16(0x00FF)), _mm_set1_epi16(k.y_offset));
+  d = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+  e = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+}
+
+
+static inline void load_planar8_sse2(const uint8_t* y, const uint8_t* u, const uint8_t* v, const yuv2rgb_coefficients& k,
+                                     __m128i& c, __m128i& d, __m128i& e)
+{
+  const __m128i zero = _mm_setzero_si128();
+
+  int32_t u4, v4;
+  memcpy(&u4, u, 4);
+  memcpy(&v4, v, 4);
+
+  __m128i uu = _mm_unpacklo_epi8(_mm_cvtsi32_si128(u4), zero);
+  __m128i vv = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v4), zero);
+
+  c = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) y), zero), _mm_set1_epi16(k.y_offset));
+  d = _mm_sub_epi16(_mm_unpacklo_epi16(uu, uu), _mm_set1_epi16(128));
+  e = _mm_sub_epi16(_mm_unpacklo_epi16(vv, vv), _mm_set1_epi16(128));
+}
+
+
+static inline void store_rgb16_sse2(__m128i r, __m128i g, __m128i b, uint8_t* out)
+{
+  alignas(16) uint8_t rr[16], gg[16], bb[16];
+  _mm_store_si128((__m128i*) rr, r);
+  _mm_store_si128((__m128i*) gg, g);
+  _mm_store_si128((__m128i*) bb, b);
+
+  for (int i = 0; i < 16; i++) {
+    out[3 * i + 0] = rr[i];
+    out[3 * i + 1] = gg[i];
+    out[3 * i + 2] = bb[i];
+  }
+}
+
+
+static int yuyv_row_to_rgb8_sse2(const uint8_t* in, uint8_t* out, int width, const yuv2rgb_coefficients& k)
+{
+  int x;
+  for (x = 0; x + 16 <= width; x += 16) {
+    __m128i c, d, e, r0, g0, b0, r1, g1, b1;
+
+    load_yuyv8_sse2(in + 2 * x, k, c, d, e);
+    yuv2rgb8_sse2(c, d, e, k, r0, g0, b0);
+    load_yuyv8_sse2(in + 2 * x + 16, k, c, d, e);
+    yuv2rgb8_sse2(c, d, e, k, r1, g1, b1);
+
+    store_rgb16_sse2(_mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(b0, b1), out + 3 * x);
+  }
+
+  return x;
+}
+
+
+static int yuv_planar_row_to_rgb8_sse2(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* out, int width,
+                                       const yuv2rgb_coefficients& k)
+{
+  int x;
+  for (x = 0; x + 16 <= width; x += 16) {
+    __m128i c, d, e, r0, g0, b0, r1, g1, b1;
+
+    load_planar8_sse2(y + x, u + x / 2, v + x / 2, k, c, d, e);
+    yuv2rgb8_sse2(c, d, e, k, r0, g0, b0);
+    load_planar8_sse2(y + x + 8, u + x / 2 + 4, v + x / 2 + 4, k, c, d, e);
+    yuv2rgb8_sse2(c, d, e, k, r1, g1, b1);
+
+    store_rgb16_sse2(_mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(b0, b1), out + 3 * x);
+  }
+
+  return x;
+}
+
+
+// --- AVX2, 16 pixels per iteration. Selected at runtime, the library is not built with -mavx2.
+
+#define VIDIO_TARGET_AVX2 __attribute__((target("avx2")))
+
+VIDIO_TARGET_AVX2
+static inline __m256i coeff_pair_avx2(int16_t a, int16_t b)
+{
+  return _mm256_set1_epi32((int) (uint16_t) a | ((int) (uint16_t) b << 16));
+}
+
+
+// Same as yuv2rgb8_sse2(), but for 16 pixels. Output is R, G, B as unsigned 8 bit.
+VIDIO_TARGET_AVX2
+static inline void yuv2rgb16_avx2(__m256i c, __m256i d, __m256i e, const yuv2rgb_coefficients& k,
+                                  __m128i& r, __m128i& g, __m128i& b)
+{
+  const __m256i y_vr = coeff_pair_avx2(k.y, k.v_r);
+  const __m256i y_ug = coeff_pair_avx2(k.y, k.u_g);
+  const __m256i y_ub = coeff_pair_avx2(k.y, k.u_b);
+  const __m256i vg_0 = coeff_pair_avx2(k.v_g, 0);
+  const __m256i round = _mm256_set1_epi32(128);
+
+  // unpack and pack work within 128 bit lanes, so the pixel order is restored by packs_epi32()
+
+  __m256i ce_lo = _mm256_unpacklo_epi16(c, e);
+  __m256i ce_hi = _mm256_unpackhi_epi16(c, e);
+  __m256i cd_lo = _mm256_unpacklo_epi16(c, d);
+  __m256i cd_hi = _mm256_unpackhi_epi16(c, d);
+  __m256i e_lo = _mm256_unpacklo_epi16(e, _mm256_setzero_si256());
+  __m256i e_hi = _mm256_unpackhi_epi16(e, _mm256_setzero_si256());
+
+  __m256i r_lo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(ce_lo, y_vr), round), 8);
+  __m256i r_hi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(ce_hi, y_vr), round), 8);
+
+  __m256i g_lo = _mm256_add_epi32(_mm256_madd_epi16(cd_lo, y_ug), _mm256_madd_epi16(e_lo, vg_0));
+  __m256i g_hi = _mm256_add_epi32(_mm256_madd_epi16(cd_hi, y_ug), _mm256_madd_epi16(e_hi, vg_0));
+  g_lo = _mm256_srai_epi32(_mm256_add_epi32(g_lo, round), 8);
+  g_hi = _mm256_srai_epi32(_mm256_add_epi32(g_hi, round), 8);
+
+  __m256i b_lo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(cd_lo, y_ub), round), 8);
+  __m256i b_hi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(cd_hi, y_ub), round), 8);
+
+  __m256i r16 = _mm256_packs_epi32(r_lo, r_hi);
+  __m256i g16 = _mm256_packs_epi32(g_lo, g_hi);
+  __m256i b16 = _mm256_packs_epi32(b_lo, b_hi);
+
+  // packus_epi16(x,x) gives pixels 0-7 in qword 0 and 8-15 in qword 2
+  __m256i rgb_r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r16, r16), _MM_SHUFFLE(3, 1, 2, 0));
+  __m256i rgb_g = _mm256_permute4x64_epi64(_mm256_packus_epi16(g16, g16), _MM_SHUFFLE(3, 1, 2, 0));
+  __m256i rgb_b = _mm256_permute4x64_epi64(_mm256_packus_epi16(b16, b16), _MM_SHUFFLE(3, 1, 2, 0));
+
+  r = _mm256_castsi256_si128(rgb_r);
+  g = _mm256_castsi256_si128(rgb_g);
+  b = _mm256_castsi256_si128(rgb_b);
+}
+
+
+// Shuffle masks for interleaving 16 R, G, B bytes into 48 bytes RGB24: rgb_shuffle_masks[output block][channel]
+struct rgb_shuffle_masks
+{
+  alignas(16) uint8_t mask[3][3][16]{};
+
+  constexpr rgb_shuffle_masks()
+  {
+    for (int block = 0; block < 3; block++)
+      for (int channel = 0; channel < 3; channel++)
+        for (int i = 0; i < 16; i++) {
+          int pos = block * 16 + i;
+          mask[block][channel][i] = (pos % 3 == channel) ? static_cast<uint8_t>(pos / 3) : 0x80;
+        }
+  }
+};
+
+static constexpr rgb_shuffle_masks s_rgb_shuffle_masks;
+
+
+VIDIO_TARGET_AVX2
+static inline void store_rgb16_avx2(__m128i r, __m128i g, __m128i b, uint8_t* out)
+{
+  for (int block = 0; block < 3; block++) {
+    const auto& m = s_rgb_shuffle_masks.mask[block];
+
+    __m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, _mm_load_si128((const __m128i*) m[0])),
+                                          _mm_shuffle_epi8(g, _mm_load_si128((const __m128i*) m[1]))),
+                             _mm_shuffle_epi8(b, _mm_load_si128((const __m128i*) m[2])));
+
+    _mm_storeu_si128((__m128i*) (out + 16 * block), v);
+  }
+}
+
+
+VIDIO_TARGET_AVX2
+static int yuyv_row_to_rgb8_avx2(const uint8_t* in, uint8_t* out, int width, const yuv2rgb_coefficients& k)
+{
+  int x;
+  for (x = 0; x + 16 <= width; x += 16) {
+    __m256i a = _mm256_loadu_si256((const __m256i*) (in + 2 * x));
+    __m256i uv = _mm256_sub_epi16(_mm256_srli_epi16(a, 8), _mm256_set1_epi16(128));
+
+    __m256i c = _mm256_sub_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x00FF)), _mm256_set1_epi16(k.y_offset));
+    __m256i d = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    __m256i e = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+    __m128i r, g, b;
+    yuv2rgb16_avx2(c, d, e, k, r, g, b);
+    store_rgb16_avx2(r, g, b, out + 3 * x);
+  }
+
+  return x;
+}
+
+
+VIDIO_TARGET_AVX2
+static int yuv_planar_row_to_rgb8_avx2(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* out, int width,
+                                       const yuv2rgb_coefficients& k)
+{
+  int x;
+  for (x = 0; x + 16 <= width; x += 16) {
+    // Zero-extend the 8 chroma samples to 32 bit and replicate them into the upper 16 bits.
+    __m256i u32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (u + x / 2)));
+    __m256i v32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (v + x / 2)));
+
+    __m256i c = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (y + x))),
+                                 _mm256_set1_epi16(k.y_offset));
+    __m256i d = _mm256_sub_epi16(_mm256_or_si256(u32, _mm256_slli_epi32(u32, 16)), _mm256_set1_epi16(128));
+    __m256i e = _mm256_sub_epi16(_mm256_or_si256(v32, _mm256_slli_epi32(v32, 16)), _mm256_set1_epi16(128));
+
+    __m128i r, g, b;
+    yuv2rgb16_avx2(c, d, e, k, r, g, b);
+    store_rgb16_avx2(r, g, b, out + 3 * x);
+  }
+
+  return x;
+}
+
+#endif
+
+
+#if VIDIO_YUV2RGB_NEON
+
+// --- NEON, 16 pixels per iteration
+
+static inline int16x8_t yuv2rgb_channel_neon(int16x8_t c, int16x8_t a, int16_t ka, int16x8_t b, int16_t kb, int16_t ky)
+{
+  int32x4_t lo = vmull_n_s16(vget_low_s16(c), ky);
+  int32x4_t hi = vmull_n_s16(vget_high_s16(c), ky);
+
+  lo = vmlal_n_s16(lo, vget_low_s16(a), ka);
+  hi = vmlal_n_s16(hi, vget_high_s16(a), ka);
+  lo = vmlal_n_s16(lo, vget_low_s16(b), kb);
+  hi = vmlal_n_s16(hi, vget_high_s16(b), kb);
+
+  lo = vshrq_n_s32(vaddq_s32(lo, vdupq_n_s32(128)), 8);
+  hi = vshrq_n_s32(vaddq_s32(hi, vdupq_n_s32(128)), 8);
+
+  return vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+}
+
+
+// Input: 16 pixels of Y, U, V with the chroma already replicated to both pixels of each pair.
+static inline void yuv2rgb16_neon(uint8x16_t y, uint8x16_t u, uint8x16_t v, const yuv2rgb_coefficients& k,
+                                  uint8_t* out)
+{
+  const int16x8_t y_offset = vdupq_n_s16(k.y_offset);
+  const int16x8_t c128 = vdupq_n_s16(128);
+
+  int16x8_t c[2], d[2], e[2];
+  c[0] = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y))), y_offset);
+  c[1] = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y))), y_offset);
+  d[0] = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(u))), c128);
+  d[1] = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(u))), c128);
+  e[0] = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v))), c128);
+  e[1] = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v))), c128);
+
+  uint8x16x3_t rgb;
+  uint8x8_t r[2], g[2], b[2];
+  for (int i = 0; i < 2; i++) {
+    r[i] = vqmovun_s16(yuv2rgb_channel_neon(c[i], e[i], k.v_r, d[i], 0, k.y));
+    g[i] = vqmovun_s16(yuv2rgb_channel_neon(c[i], d[i], k.u_g, e[i], k.v_g, k.y));
+    b[i] = vqmovun_s16(yuv2rgb_channel_neon(c[i], d[i], k.u_b, e[i], 0, k.y));
+  }
+
+  rgb.val[0] = vcombine_u8(r[0], r[1]);
+  rgb.val[1] = vcombine_u8(g[0], g[1]);
+  rgb.val[2] = vcombine_u8(b[0], b[1]);
+  vst3q_u8(out, rgb);
+}
+
+
+static int yuyv_row_to_rgb8_neon(const uint8_t* in, uint8_t* out, int width, const yuv2rgb_coefficients& k)
+{
+  int x;
+  for (x = 0; x + 16 <= width; x += 16) {
+    uint8x8x4_t yuyv = vld4_u8(in + 2 * x); // Y0, U, Y1, V of 8 pixel pairs
+
+    uint8x8x2_t y = vzip_u8(yuyv.val[0], yuyv.val[2]);
+    uint8x8x2_t u = vzip_u8(yuyv.val[1], yuyv.val[1]);
+    uint8x8x2_t v = vzip_u8(yuyv.val[3], yuyv.val[3]);
+
+    yuv2rgb16_neon(vcombine_u8(y.val[0], y.val[1]),
+                   vcombine_u8(u.val[0], u.val[1]),
+                   vcombine_u8(v.val[0], v.val[1]), k, out + 3 * x);
+  }
+
+  return x;
+}
+
+
+static int yuv_planar_row_to_rgb8_neon(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* out, int width,
+                                       const yuv2rgb_coefficients& k)
+{
+  int x;
+  for (x = 0; x + 16 <= width; x += 16) {
+    uint8x8_t u8 = vld1_u8(u + x / 2);
+    uint8x8_t v8 = vld1_u8(v + x / 2);
+
+    uint8x8x2_t uu = vzip_u8(u8, u8);
+    uint8x8x2_t vv = vzip_u8(v8, v8);
+
+    yuv2rgb16_neon(vld1q_u8(y + x),
+                   vcombine_u8(uu.val[0], uu.val[1]),
+                   vcombine_u8(vv.val[0], vv.val[1]), k, out + 3 * x);
+  }
+
+  return x;
+}
+
+#endif
+
+
+// --- dispatch
+
+static std::vector<yuv2rgb_kernels> find_available_kernels()
+{
+  std::vector<yuv2rgb_kernels> kernels;
+  kernels.push_back({"scalar", nullptr, nullptr});
+
+#if VIDIO_YUV2RGB_X86
+  kernels.push_back({"sse2", yuyv_row_to_rgb8_sse2, yuv_planar_row_to_rgb8_sse2});
+
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.push_back({"avx2", yuyv_row_to_rgb8_avx2, yuv_planar_row_to_rgb8_avx2});
+  }
+#elif VIDIO_YUV2RGB_NEON
+  kernels.push_back({"neon", yuyv_row_to_rgb8_neon, yuv_planar_row_to_rgb8_neon});
+#endif
+
+  return kernels;
+}
+
+
+const std::vector<yuv2rgb_kernels>& get_available_yuv2rgb_kernels()
+{
+  static const std::vector<yuv2rgb_kernels> kernels = find_available_kernels();
+  return kernels;
+}
+
+
+static const yuv2rgb_kernels& get_kernels()
+{
+  static const yuv2rgb_kernels& kernels = get_available_yuv2rgb_kernels().back();
+  return kernels;
+}
+
+
+void yuyv_row_to_rgb8(const uint8_t* yuyv, uint8_t* rgb, int width, const yuv2rgb_coefficients& coeffs)
+{
+  yuyv_row_to_rgb8(yuyv, rgb, width, coeffs, get_kernels());
+}
+
+
+void yuyv_row_to_rgb8(const uint8_t* yuyv, uint8_t* rgb, int width, const yuv2rgb_coefficients& coeffs,
+                      const yuv2rgb_kernels& kernels)
+{
+  int x = 0;
+
+  // The SIMD kernels convert blocks of 16 pixels, the scalar code does the remaining pixels.
+  if (auto kernel = kernels.yuyv) {
+    x = kernel(yuyv, rgb, width, coeffs);
+  }
+
+  yuyv_row_to_rgb8_scalar(yuyv + 2 * x, rgb + 3 * x, width - x, coeffs);
+
+  // The last pixel of an odd width row has no V sample of its own. Take it from the previous pixel pair.
+  if (width & 1) {
+    x = width - 1;
+    int v = (x > 0) ? yuyv[2 * x - 1] : 128;
+    yuv_pixel_to_rgb8(yuyv[2 * x + 0], yuyv[2 * x + 1], v, rgb + 3 * x, coeffs);
+  }
+}
+
+
+void yuv_planar_row_to_rgb8(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, int width,
+                            const yuv2rgb_coefficients& coeffs)
+{
+  yuv_planar_row_to_rgb8(y, u, v, rgb, width, coeffs, get_kernels());
+}
+
+
+void yuv_planar_row_to_rgb8(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, int width,
+                            const yuv2rgb_coefficients& coeffs, const yuv2rgb_kernels& kernels)
+{
+  int x = 0;
+
+  if (auto kernel = kernels.planar) {
+    x = kernel(y, u, v, rgb, width, coeffs);
+  }
+
+  yuv_planar_row_to_rgb8_scalar(y + x, u + x / 2, v + x / 2, rgb + 3 * x, width - x, coeffs);
+}
+
+
+vidio_frame* yuyv_to_rgb8(const vidio_frame* input, int num_threads)
 {
   int w = input->get_width();
   int h = input->get_height();
@@ -40,34 +540,51 @@ vidio_frame* yuyv_to_rgb8(const vidio_frame* input)
   int out_stride;
   out = out_frame->get_plane(vidio_color_channel_interleaved, &out_stride);
 
-  for (int y = 0; y < h; y++) {
-    for (int x = 0; x < w - 1; x += 2) {
-      int y1 = in[y * in_stride + x * 2 + 0] - 16;
-      int y2 = in[y * in_stride + x * 2 + 2] - 16;
-      int u = in[y * in_stride + x * 2 + 1] - 128;
-      int v = in[y * in_stride + x * 2 + 3] - 128;
+  const auto& coeffs = get_yuv2rgb_coefficients(input->get_color_matrix(), input->get_color_range());
 
-      out[y * out_stride + 3 * x + 0] = clip8(1.164 * y1 + 1.1596 * v);
-      out[y * out_stride + 3 * x + 1] = clip8(1.164 * y1 - 0.392 * u - 0.813 * v);
-      out[y * out_stride + 3 * x + 2] = clip8(1.164 * y1 + 2.017 * u);
+  num_threads = vidio_thread_pool::get_effective_num_threads(num_threads);
+  auto slices = split_into_row_slices(h, num_threads, 1);
 
-      out[y * out_stride + 3 * x + 3] = clip8(1.164 * y2 + 1.1596 * v);
-      out[y * out_stride + 3 * x + 4] = clip8(1.164 * y2 - 0.392 * u - 0.813 * v);
-      out[y * out_stride + 3 * x + 5] = clip8(1.164 * y2 + 2.017 * u);
+  vidio_thread_pool::get_instance().parallel_for((int) slices.size(), num_threads, [&](int i) {
+    for (int y = slices[i].first_row; y < slices[i].end_row; y++) {
+      yuyv_row_to_rgb8(in + y * in_stride, out + y * out_stride, w, coeffs);
     }
+  });
+
+  out_frame->copy_metadata_from(input);
+  return out_frame;
+}
+
+
+vidio_frame* yuv420_to_rgb8(const vidio_frame* input, int num_threads)
+{
+  int w = input->get_width();
+  int h = input->get_height();
 
-    if (w & 1) {
-      int x = w - 1;
+  vidio_frame* out_frame = new vidio_frame();
+  out_frame->set_format(vidio_pixel_format_RGB8, w, h);
+  out_frame->add_raw_plane(vidio_color_channel_interleaved, w, h, 24);
 
-      int y1 = in[y * in_stride + x * 2 + 0] - 16;
-      int u = in[y * in_stride + x * 2 + 1] - 128;
-      int v = in[y * in_stride + x * 2 + 3] - 128;
+  int y_stride, u_stride, v_stride;
+  const uint8_t* in_y = input->get_plane(vidio_color_channel_Y, &y_stride);
+  const uint8_t* in_u = input->get_plane(vidio_color_channel_U, &u_stride);
+  const uint8_t* in_v = input->get_plane(vidio_color_channel_V, &v_stride);
 
-      out[y * out_stride + 3 * x + 0] = clip8(1.164 * y1 + 1.1596 * v);
-      out[y * out_stride + 3 * x + 1] = clip8(1.164 * y1 - 0.392 * u - 0.813 * v);
-      out[y * out_stride + 3 * x + 2] = clip8(1.164 * y1 + 2.017 * u);
+  uint8_t* out;
+  int out_stride;
+  out = out_frame->get_plane(vidio_color_channel_interleaved, &out_stride);
+
+  const auto& coeffs = get_yuv2rgb_coefficients(input->get_color_matrix(), input->get_color_range());
+
+  num_threads = vidio_thread_pool::get_effective_num_threads(num_threads);
+  auto slices = split_into_row_slices(h, num_threads, 1);
+
+  vidio_thread_pool::get_instance().parallel_for((int) slices.size(), num_threads, [&](int i) {
+    for (int y = slices[i].first_row; y < slices[i].end_row; y++) {
+      yuv_planar_row_to_rgb8(in_y + y * y_stride, in_u + (y / 2) * u_stride, in_v + (y / 2) * v_stride,
+                             out + y * out_stride, w, coeffs);
     }
-  }
+  });
 
   out_frame->copy_metadata_from(input);
   return out_frame;
@@ -21,8 +21,77 @@
 #ifndef LIBVIDIO_YUV2RGB_H
 #define LIBVIDIO_YUV2RGB_H
 
+#include "common.h"
+#include "libvidio/vidio.h"
+#include <cstdint>
+#include <vector>
+
 class vidio_frame;
 
-vidio_frame* yuyv_to_rgb8(const vidio_frame* input);
+// Fixed-point YUV to RGB conversion matrix, scaled by 256:
+//   R = (y * (Y - y_offset)                 + v_r * (V - 128) + 128) >> 8
+//   G = (y * (Y - y_offset) + u_g * (U-128) + v_g * (V - 128) + 128) >> 8
+//   B = (y * (Y - y_offset) + u_b * (U-128)                   + 128) >> 8
+struct yuv2rgb_coefficients
+{
+  int16_t y;
+  int16_t v_r;
+  int16_t u_g;
+  int16_t v_g;
+  int16_t u_b;
+  int16_t y_offset;
+};
+
+// Precomputed coefficients for each matrix and range. Unknown values fall back to BT.601, limited range.
+const yuv2rgb_coefficients& get_yuv2rgb_coefficients(vidio_color_matrix matrix, vidio_color_range range);
+
+// Reference conversion of a single pixel. The SIMD kernels give exactly the same results.
+inline void yuv_pixel_to_rgb8(int y, int u, int v, uint8_t* rgb, const yuv2rgb_coefficients& c)
+{
+  int luma = c.y * (y - c.y_offset) + 128;
+  int d = u - 128;
+  int e = v - 128;
+
+  int r = (luma + c.v_r * e) >> 8;
+  int g = (luma + c.u_g * d + c.v_g * e) >> 8;
+  int b = (luma + c.u_b * d) >> 8;
+
+  rgb[0] = clip8(r);
+  rgb[1] = clip8(g);
+  rgb[2] = clip8(b);
+}
+
+// SIMD row kernels. They convert blocks of 16 pixels and return the number of converted pixels.
+using yuyv_row_kernel = int (*)(const uint8_t*, uint8_t*, int, const yuv2rgb_coefficients&);
+using planar_row_kernel = int (*)(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const yuv2rgb_coefficients&);
+
+struct yuv2rgb_kernels
+{
+  const char* name;
+  yuyv_row_kernel yuyv;  // nullptr: scalar code only
+  planar_row_kernel planar;
+};
+
+// The kernels compiled into the library that the CPU supports, starting with the scalar code.
+// The last one is used by default. Other entries are only selected explicitly (e.g. to test each code path).
+const std::vector<yuv2rgb_kernels>& get_available_yuv2rgb_kernels();
+
+// Converts one row of YUYV to RGB8. Uses SSE2/AVX2 or NEON if available. All code paths give identical results.
+void yuyv_row_to_rgb8(const uint8_t* yuyv, uint8_t* rgb, int width, const yuv2rgb_coefficients& coeffs);
+
+void yuyv_row_to_rgb8(const uint8_t* yuyv, uint8_t* rgb, int width, const yuv2rgb_coefficients& coeffs,
+                      const yuv2rgb_kernels& kernels);
+
+// Converts one row of planar YUV with horizontally subsampled chroma (4:2:2 or a row of 4:2:0) to RGB8.
+void yuv_planar_row_to_rgb8(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, int width,
+                            const yuv2rgb_coefficients& coeffs);
+
+void yuv_planar_row_to_rgb8(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, int width,
+                            const yuv2rgb_coefficients& coeffs, const yuv2rgb_kernels& kernels);
+
+// With num_threads > 1, horizontal slices of the frame are converted in parallel (0: one thread per CPU core).
+vidio_frame* yuyv_to_rgb8(const vidio_frame* input, int num_threads = 1);
+
+vidio_frame* yuv420_to_rgb8(const vidio_frame* input, int num_threads = 1);
 
 #endif //LIBVIDIO_YUV2RGB_H
@@ -20,6 +20,8 @@
 
 #include "vidio_file_reader.h"
 #include <libvidio/vidio_frame.h>
+#include <libvidio/vidio_frame_pool.h>
+#include <libvidio/colorconversion/ffmpeg.h>
 
 extern "C" {
 #include <libavutil/imgutils.h>
@@ -233,6 +235,40 @@ void vidio_file_reader::close()
 }
 
 
+void vidio_file_reader::set_sws_colorimetry(vidio_color_matrix matrix, vidio_color_range range)
+{
+  if (matrix != m_sws_color_matrix || range != m_sws_color_range) {
+    set_swscale_colorimetry(m_sws_context, matrix, range, false);
+    m_sws_color_matrix = matrix;
+    m_sws_color_range = range;
+  }
+}
+
+
+static vidio_frame::plane_layout yuv420_plane_layout(int w, int h)
+{
+  int cw = (w + 1) / 2;
+  int ch = (h + 1) / 2;
+
+  return {{vidio_color_channel_Y, vidio_channel_format_pixels, w, h, 8},
+          {vidio_color_channel_U, vidio_channel_format_pixels, cw, ch, 8},
+          {vidio_color_channel_V, vidio_channel_format_pixels, cw, ch, 8}};
+}
+
+
+vidio_frame* vidio_file_reader::create_frame(vidio_pixel_format format, int w, int h,
+                                             const vidio_frame::plane_layout& layout)
+{
+  if (m_frame_pool) {
+    return m_frame_pool->acquire_frame(format, w, h, layout);
+  }
+
+  auto* frame = new vidio_frame();
+  frame->set_format(format, w, h);
+  return frame;
+}
+
+
 vidio_frame* vidio_file_reader::create_compressed_frame(AVPacket* pkt)
 {
   // Convert AVCC → Annex B if bitstream filter is active
@@ -244,9 +280,6 @@ vidio_frame* vidio_file_reader::create_compressed_frame(AVPacket* pkt)
     }
   }
 
-  auto* frame = new vidio_frame();
-  frame->set_format(m_pixel_format, m_width, m_height);
-
   vidio_channel_format channel_format;
   switch (m_pixel_format) {
     case vidio_pixel_format_H264:
@@ -263,6 +296,9 @@ vidio_frame* vidio_file_reader::create_compressed_frame(AVPacket* pkt)
       break;
   }
 
+  auto* frame = create_frame(m_pixel_format, m_width, m_height,
+                             {{vidio_color_channel_compressed, channel_format, m_width, m_height, 8}});
+
   frame->add_compressed_plane(vidio_color_channel_compressed,
                               channel_format, 8,
                               pkt->data, pkt->size,
@@ -274,6 +310,7 @@ vidio_frame* vidio_file_reader::create_compressed_frame(AVPacket* pkt)
   if (pkt->pts != AV_NOPTS_VALUE) {
     int64_t pts_us = av_rescale_q(pkt->pts, time_base, {1, 1000000});
     frame->set_timestamp_us(static_cast<uint64_t>(pts_us));
+    frame->set_clock_domain(vidio_clock_domain_stream);
   }
 
   if (pkt->dts != AV_NOPTS_VALUE) {
@@ -310,6 +347,10 @@ vidio_frame* vidio_file_reader::decode_frame(AVPacket* pkt)
     return nullptr;
   }
 
+  vidio_color_matrix color_matrix;
+  vidio_color_range color_range;
+  get_avframe_colorimetry(av_frame, color_matrix, color_range);
+
   // Convert to YUV420 planar via swscale if needed
   AVPixelFormat src_format = static_cast<AVPixelFormat>(av_frame->format);
   AVPixelFormat dst_format = AV_PIX_FMT_YUV420P;
@@ -320,6 +361,12 @@ vidio_frame* vidio_file_reader::decode_frame(AVPacket* pkt)
           av_frame->width, av_frame->height, src_format,
           av_frame->width, av_frame->height, dst_format,
           SWS_BILINEAR, nullptr, nullptr, nullptr);
+
+      if (m_sws_context) {
+        set_swscale_colorimetry(m_sws_context, color_matrix, color_range, false);
+        m_sws_color_matrix = color_matrix;
+        m_sws_color_range = color_range;
+      }
     }
 
     if (!m_sws_context) {
@@ -327,6 +374,9 @@ vidio_frame* vidio_file_reader::decode_frame(AVPacket* pkt)
       return nullptr;
     }
 
+    // Keep the range of the source, such that the frame colorimetry stays valid.
+    set_sws_colorimetry(color_matrix, color_range);
+
     AVFrame* dst_frame = av_frame_alloc();
     dst_frame->width = av_frame->width;
     dst_frame->height = av_frame->height;
@@ -346,8 +396,8 @@ vidio_frame* vidio_file_reader::decode_frame(AVPacket* pkt)
   }
 
   // Build vidio_frame from decoded AVFrame
-  auto* frame = new vidio_frame();
-  frame->set_format(vidio_pixel_format_YUV420_planar, av_frame->width, av_frame->height);
+  auto* frame = create_frame(vidio_pixel_format_YUV420_planar, av_frame->width, av_frame->height,
+                             yuv420_plane_layout(av_frame->width, av_frame->height));
 
   frame->add_raw_plane(vidio_color_channel_Y, 8);
   frame->add_raw_plane(vidio_color_channel_U, 8);
@@ -387,8 +437,11 @@ vidio_frame* vidio_file_reader::decode_frame(AVPacket* pkt)
   if (av_frame->pts != AV_NOPTS_VALUE) {
     int64_t pts_us = av_rescale_q(av_frame->pts, time_base, {1, 1000000});
     frame->set_timestamp_us(static_cast<uint64_t>(pts_us));
+    frame->set_clock_domain(vidio_clock_domain_stream);
   }
 
+  frame->set_colorimetry(color_matrix, color_range);
+
   // Decoded frames are always independently displayable
   frame->set_keyframe(true);
 
@@ -424,14 +477,21 @@ vidio_frame* vidio_file_reader::flush_decoder()
 
   // Reuse decode path for conversion
   // We need to wrap this in a packet-like call; instead, build frame directly
-  auto* frame = new vidio_frame();
-  frame->set_format(vidio_pixel_format_YUV420_planar, av_frame->width, av_frame->height);
+  auto* frame = create_frame(vidio_pixel_format_YUV420_planar, av_frame->width, av_frame->height,
+                             yuv420_plane_layout(av_frame->width, av_frame->height));
+
+  vidio_color_matrix color_matrix;
+  vidio_color_range color_range;
+  get_avframe_colorimetry(av_frame, color_matrix, color_range);
+  frame->set_colorimetry(color_matrix, color_range);
 
   // Same conversion logic as decode_frame
   AVPixelFormat src_format = static_cast<AVPixelFormat>(av_frame->format);
   AVPixelFormat dst_format = AV_PIX_FMT_YUV420P;
 
   if (src_format != dst_format && m_sws_context) {
+    set_sws_colorimetry(color_matrix, color_range);
+
     AVFrame* dst_frame = av_frame_alloc();
     dst_frame->width = av_frame->width;
     dst_frame->height = av_frame->height;
@@ -484,6 +544,7 @@ vidio_frame* vidio_file_reader::flush_decoder()
   if (av_frame->pts != AV_NOPTS_VALUE) {
     int64_t pts_us = av_rescale_q(av_frame->pts, time_base, {1, 1000000});
     frame->set_timestamp_us(static_cast<uint64_t>(pts_us));
+    frame->set_clock_domain(vidio_clock_domain_stream);
   }
 
   frame->set_keyframe(true);
@@ -23,6 +23,7 @@
 
 #include <libvidio/vidio.h>
 #include <libvidio/vidio_error.h>
+#include <libvidio/vidio_frame.h>
 #include <string>
 #include <atomic>
 
@@ -35,6 +36,7 @@ extern "C" {
 
 struct vidio_frame;
 struct vidio_input_file;
+class vidio_frame_pool;
 
 
 class vidio_file_reader
@@ -60,6 +62,9 @@ public:
   // Read next frame. Returns nullptr on EOF. Caller owns the returned frame.
   vidio_frame* read_next_frame();
 
+  // If set, frames are taken from this pool instead of being allocated.
+  void set_frame_pool(vidio_frame_pool* pool) { m_frame_pool = pool; }
+
   // Seek to the beginning of the file for looping.
   bool seek_to_beginning();
 
@@ -74,6 +79,11 @@ private:
   // Decoder state (only used for non-passthrough codecs)
   AVCodecContext* m_codec_context = nullptr;
   SwsContext* m_sws_context = nullptr;
+  vidio_color_matrix m_sws_color_matrix = vidio_color_matrix_unknown;
+  vidio_color_range m_sws_color_range = vidio_color_range_unknown;
+
+  // Sets the colorimetry of m_sws_context if it differs from the one of the previous frame.
+  void set_sws_colorimetry(vidio_color_matrix matrix, vidio_color_range range);
 
   int m_width = 0;
   int m_height = 0;
@@ -85,6 +95,10 @@ private:
 
   std::atomic<bool> m_stop{false};
 
+  vidio_frame_pool* m_frame_pool = nullptr;
+
+  vidio_frame* create_frame(vidio_pixel_format format, int w, int h, const vidio_frame::plane_layout& layout);
+
   static bool is_passthrough_codec(AVCodecID codec_id);
   vidio_pixel_format codec_id_to_pixel_format(AVCodecID codec_id) const;
   vidio_frame* create_compressed_frame(AVPacket* pkt);
@@ -27,6 +27,7 @@
 vidio_input_file::vidio_input_file(const std::string& filepath)
     : m_filepath(filepath), m_reader(std::make_unique<vidio_file_reader>())
 {
+  m_reader->set_frame_pool(&get_frame_pool());
 }
 
 
@@ -35,16 +36,13 @@ vidio_input_file::~vidio_input_file()
   // Force full stop regardless of stop mode
   m_stop_requested = true;
   m_reader->stop();
+  m_frame_queue.interrupt_producer();
   if (m_capturing_thread.joinable()) {
     m_capturing_thread.join();
   }
   m_reader->close();
 
-  std::lock_guard<std::mutex> lock(m_queue_mutex);
-  for (auto* frame : m_frame_queue) {
-    delete frame;
-  }
-  m_frame_queue.clear();
+  clear_frame_queue();
 }
 
 
@@ -130,6 +128,9 @@ const vidio_error* vidio_input_file::start_capturing()
         opt_framerate);
   }
 
+  m_frame_queue.resume_producer();
+  m_frame_queue.reset_end_of_stream();
+
   // In continue mode, thread may still be running — don't start a second one
   if (m_capturing_thread.joinable()) {
     return nullptr;
@@ -219,6 +220,9 @@ void vidio_input_file::capturing_thread_func()
 
 const vidio_error* vidio_input_file::stop_capturing()
 {
+  // Do not keep the capturing thread blocked in a full queue.
+  m_frame_queue.interrupt_producer();
+
   if (m_stop_mode == vidio_file_stop_mode_continue) {
     // Continue mode: don't stop the thread, just let frames overflow and discard
     return nullptr;
@@ -238,64 +242,12 @@ const vidio_error* vidio_input_file::stop_capturing()
   m_stop_requested = false;
 
   // Clear stale frames from queue
-  {
-    std::lock_guard<std::mutex> lock(m_queue_mutex);
-    for (auto* frame : m_frame_queue) {
-      delete frame;
-    }
-    m_frame_queue.clear();
-  }
+  clear_frame_queue();
 
   return nullptr;
 }
 
 
-const vidio_frame* vidio_input_file::peek_next_frame() const
-{
-  std::lock_guard<std::mutex> lock(m_queue_mutex);
-
-  if (m_frame_queue.empty()) {
-    return nullptr;
-  }
-  else {
-    return m_frame_queue.front();
-  }
-}
-
-
-void vidio_input_file::pop_next_frame()
-{
-  std::lock_guard<std::mutex> lock(m_queue_mutex);
-  delete m_frame_queue.front();
-  m_frame_queue.pop_front();
-}
-
-
-void vidio_input_file::push_frame_into_queue(const vidio_frame* f)
-{
-  bool overflow = false;
-
-  {
-    std::lock_guard<std::mutex> lock(m_queue_mutex);
-
-    if (m_frame_queue.size() < cMaxFrameQueueLength) {
-      m_frame_queue.push_back(f);
-    }
-    else {
-      overflow = true;
-      delete f;
-    }
-  }
-
-  if (overflow) {
-    send_callback_message(vidio_input_message_input_overflow);
-  }
-  else {
-    send_callback_message(vidio_input_message_new_frame);
-  }
-}
-
-
 std::string vidio_input_file::serialize(vidio_serialization_format serialformat) const
 {
 #if WITH_JSON
@@ -29,7 +29,6 @@
 #include "vidio_file_reader.h"
 #include "vidio_video_format_file.h"
 #include <atomic>
-#include <deque>
 #include <thread>
 #include <mutex>
 
@@ -58,10 +57,6 @@ public:
 
   const vidio_error* stop_capturing() override;
 
-  const vidio_frame* peek_next_frame() const override;
-
-  void pop_next_frame() override;
-
   std::string serialize(vidio_serialization_format serialformat) const override;
 
   void set_loop(bool loop) { m_loop = loop; }
@@ -73,8 +68,6 @@ public:
                                                 const nlohmann::json& json);
 #endif
 
-  void push_frame_into_queue(const vidio_frame* f);
-
 private:
   explicit vidio_input_file(const std::string& filepath);
 
@@ -84,11 +77,6 @@ private:
 
   std::thread m_capturing_thread;
 
-  std::deque<const vidio_frame*> m_frame_queue;
-  mutable std::mutex m_queue_mutex;
-
-  static const int cMaxFrameQueueLength = 20;
-
   bool m_opened = false;
   bool m_loop = true;
   vidio_file_stop_mode m_stop_mode = vidio_file_stop_mode_pause;
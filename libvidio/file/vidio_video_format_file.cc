@@ -180,9 +180,17 @@ vidio_pixel_format_class vidio_video_format_file::pixel_format_to_class(vidio_pi
       return vidio_pixel_format_class_MJPEG;
     case vidio_pixel_format_RGB8:
     case vidio_pixel_format_RGB8_planar:
+    case vidio_pixel_format_BGR8:
+    case vidio_pixel_format_RGBA8:
+    case vidio_pixel_format_BGRA8:
       return vidio_pixel_format_class_RGB;
     case vidio_pixel_format_YUV420_planar:
     case vidio_pixel_format_YUV422_YUYV:
+    case vidio_pixel_format_YUV420_NV12:
+    case vidio_pixel_format_YUV422_NV16:
+    case vidio_pixel_format_YUV420_NV21:
+    case vidio_pixel_format_YUV422_UYVY:
+    case vidio_pixel_format_GREY8:
       return vidio_pixel_format_class_YUV;
     default:
       return vidio_pixel_format_class_unknown;
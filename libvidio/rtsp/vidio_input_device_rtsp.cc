@@ -46,11 +46,7 @@ vidio_input_device_rtsp::~vidio_input_device_rtsp()
   stop_capturing();
 
   // Clear any remaining frames in the queue
-  std::lock_guard<std::mutex> lock(m_queue_mutex);
-  for (auto* frame : m_frame_queue) {
-    delete frame;
-  }
-  m_frame_queue.clear();
+  clear_frame_queue();
 }
 
 
@@ -151,6 +147,9 @@ const vidio_error* vidio_input_device_rtsp::start_capturing()
         opt_framerate);
   }
 
+  m_frame_queue.resume_producer();
+  m_frame_queue.reset_end_of_stream();
+
   // Start capturing in a separate thread
   m_capturing_thread = std::thread(&vidio_rtsp_stream::start_capturing_blocking,
                                    m_stream.get(), this);
@@ -162,6 +161,7 @@ const vidio_error* vidio_input_device_rtsp::start_capturing()
 const vidio_error* vidio_input_device_rtsp::stop_capturing()
 {
   m_stream->stop_capturing();
+  m_frame_queue.interrupt_producer();
 
   if (m_capturing_thread.joinable()) {
     m_capturing_thread.join();
@@ -175,52 +175,6 @@ const vidio_error* vidio_input_device_rtsp::stop_capturing()
 }
 
 
-const vidio_frame* vidio_input_device_rtsp::peek_next_frame() const
-{
-  std::lock_guard<std::mutex> lock(m_queue_mutex);
-
-  if (m_frame_queue.empty()) {
-    return nullptr;
-  }
-  else {
-    return m_frame_queue.front();
-  }
-}
-
-
-void vidio_input_device_rtsp::pop_next_frame()
-{
-  std::lock_guard<std::mutex> lock(m_queue_mutex);
-  delete m_frame_queue.front();
-  m_frame_queue.pop_front();
-}
-
-
-void vidio_input_device_rtsp::push_frame_into_queue(const vidio_frame* f)
-{
-  bool overflow = false;
-
-  {
-    std::lock_guard<std::mutex> lock(m_queue_mutex);
-
-    if (m_frame_queue.size() < cMaxFrameQueueLength) {
-      m_frame_queue.push_back(f);
-    }
-    else {
-      overflow = true;
-      delete f;
-    }
-  }
-
-  if (overflow) {
-    send_callback_message(vidio_input_message_input_overflow);
-  }
-  else {
-    send_callback_message(vidio_input_message_new_frame);
-  }
-}
-
-
 std::string vidio_input_device_rtsp::serialize(vidio_serialization_format serialformat) const
 {
 #if WITH_JSON
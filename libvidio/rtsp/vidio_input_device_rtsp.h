@@ -28,7 +28,6 @@
 #include <libvidio/vidio_input.h>
 #include "vidio_rtsp_stream.h"
 #include "vidio_video_format_rtsp.h"
-#include <deque>
 #include <thread>
 #include <mutex>
 
@@ -60,10 +59,6 @@ public:
 
   const vidio_error* stop_capturing() override;
 
-  const vidio_frame* peek_next_frame() const override;
-
-  void pop_next_frame() override;
-
   std::string serialize(vidio_serialization_format serialformat) const override;
 
   // Configuration methods
@@ -75,8 +70,6 @@ public:
                                                        const nlohmann::json& json);
 #endif
 
-  void push_frame_into_queue(const vidio_frame* f);
-
 private:
   explicit vidio_input_device_rtsp(const std::string& url);
   vidio_input_device_rtsp(const std::string& url,
@@ -91,11 +84,6 @@ private:
 
   std::thread m_capturing_thread;
 
-  std::deque<const vidio_frame*> m_frame_queue;
-  mutable std::mutex m_queue_mutex;
-
-  static const int cMaxFrameQueueLength = 20;
-
   bool m_connected = false;
   std::unique_ptr<vidio_video_format_rtsp> m_current_format;
 
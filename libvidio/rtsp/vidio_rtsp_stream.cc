@@ -224,10 +224,6 @@ void vidio_rtsp_stream::start_capturing_blocking(vidio_input_device_rtsp* device
     }
 
     if (pkt->stream_index == m_video_stream_index) {
-      // Create a vidio_frame with the compressed data
-      auto* frame = new vidio_frame();
-      frame->set_format(m_pixel_format, m_width, m_height);
-
       // Determine channel format based on codec
       vidio_channel_format channel_format;
       switch (m_pixel_format) {
@@ -245,6 +241,11 @@ void vidio_rtsp_stream::start_capturing_blocking(vidio_input_device_rtsp* device
           break;
       }
 
+      // Create a vidio_frame with the compressed data
+      auto* frame = device->get_frame_pool().acquire_frame(m_pixel_format, m_width, m_height,
+                                                           {{vidio_color_channel_compressed, channel_format,
+                                                             m_width, m_height, 8}});
+
       frame->add_compressed_plane(vidio_color_channel_compressed,
                                   channel_format, 8,
                                   pkt->data, pkt->size,
@@ -258,6 +259,7 @@ void vidio_rtsp_stream::start_capturing_blocking(vidio_input_device_rtsp* device
       if (pkt->pts != AV_NOPTS_VALUE) {
         int64_t pts_us = av_rescale_q(pkt->pts, time_base, {1, 1000000});
         frame->set_timestamp_us(static_cast<uint64_t>(pts_us));
+        frame->set_clock_domain(vidio_clock_domain_stream);
       }
 
       // Set DTS if available (for B-frame support)
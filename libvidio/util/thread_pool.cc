@@ -0,0 +1,167 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thread_pool.h"
+#include <algorithm>
+
+
+vidio_thread_pool& vidio_thread_pool::get_instance()
+{
+  static vidio_thread_pool pool;
+  return pool;
+}
+
+
+vidio_thread_pool::~vidio_thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shutdown = true;
+  }
+
+  m_job_available.notify_all();
+
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+
+static int get_num_cpu_cores()
+{
+  return std::max(1, (int) std::thread::hardware_concurrency());
+}
+
+
+int vidio_thread_pool::get_effective_num_threads(int num_threads)
+{
+  if (num_threads > 0) {
+    return std::min(num_threads, get_num_cpu_cores());
+  }
+
+  return get_num_cpu_cores();
+}
+
+
+void vidio_thread_pool::parallel_for(int num_tasks, int max_threads, const std::function<void(int)>& task)
+{
+  // The helper threads are kept until the library is unloaded. Never start more than there are CPU cores.
+  int num_helpers = std::min({num_tasks, max_threads, get_num_cpu_cores()}) - 1;
+
+  if (num_helpers <= 0) {
+    for (int i = 0; i < num_tasks; i++) {
+      task(i);
+    }
+
+    return;
+  }
+
+  auto j = std::make_shared<job>();
+  j->task = &task;
+  j->num_tasks = num_tasks;
+  j->missing_helpers = num_helpers;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    while ((int) m_threads.size() < num_helpers) {
+      m_threads.emplace_back(&vidio_thread_pool::worker_main, this);
+    }
+
+    m_jobs.push_back(j);
+  }
+
+  m_job_available.notify_all();
+
+  process_tasks(*j);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  // All tasks have been taken, helpers that did not join yet are not needed anymore.
+  auto it = std::find(m_jobs.begin(), m_jobs.end(), j);
+  if (it != m_jobs.end()) {
+    m_jobs.erase(it);
+  }
+
+  m_job_finished.wait(lock, [&j]() { return j->finished_tasks == j->num_tasks; });
+}
+
+
+void vidio_thread_pool::process_tasks(job& j)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  while (j.next_task < j.num_tasks) {
+    int i = j.next_task++;
+
+    lock.unlock();
+    (*j.task)(i);
+    lock.lock();
+
+    j.finished_tasks++;
+  }
+
+  if (j.finished_tasks == j.num_tasks) {
+    m_job_finished.notify_all();
+  }
+}
+
+
+void vidio_thread_pool::worker_main()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;) {
+    m_job_available.wait(lock, [this]() { return m_shutdown || !m_jobs.empty(); });
+
+    if (m_shutdown) {
+      return;
+    }
+
+    std::shared_ptr<job> j = m_jobs.front();
+    if (--j->missing_helpers == 0) {
+      m_jobs.pop_front();
+    }
+
+    lock.unlock();
+    process_tasks(*j);
+    lock.lock();
+  }
+}
+
+
+std::vector<vidio_row_slice> split_into_row_slices(int height, int num_slices, int alignment)
+{
+  std::vector<vidio_row_slice> slices;
+
+  int num_blocks = (height + alignment - 1) / alignment;
+  num_slices = std::max(1, std::min(num_slices, num_blocks));
+
+  int first_row = 0;
+  for (int i = 0; i < num_slices; i++) {
+    int end_block = (int) ((int64_t) num_blocks * (i + 1) / num_slices);
+    int end_row = std::min(height, end_block * alignment);
+
+    slices.push_back({first_row, end_row});
+    first_row = end_row;
+  }
+
+  return slices;
+}
@@ -0,0 +1,88 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVIDIO_THREAD_POOL_H
+#define LIBVIDIO_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Library-wide worker threads for splitting a computation (e.g. a frame conversion) into parallel tasks.
+// Threads are started on demand and run until the library is unloaded.
+class vidio_thread_pool
+{
+public:
+  static vidio_thread_pool& get_instance();
+
+  // Calls task(i) for all i in [0, num_tasks) with at most max_threads threads in parallel,
+  // but not more than there are CPU cores. The calling thread processes tasks too.
+  // Returns when all tasks are finished.
+  void parallel_for(int num_tasks, int max_threads, const std::function<void(int)>& task);
+
+  // Resolves a configured number of threads: 0 means one thread per CPU core. Larger numbers are limited to that.
+  static int get_effective_num_threads(int num_threads);
+
+private:
+  vidio_thread_pool() = default;
+
+  ~vidio_thread_pool();
+
+  struct job
+  {
+    const std::function<void(int)>* task;
+    int num_tasks;
+    int next_task = 0;
+    int finished_tasks = 0;
+    int missing_helpers;  // number of worker threads that may still join this job
+  };
+
+  std::mutex m_mutex;
+  std::condition_variable m_job_available;
+  std::condition_variable m_job_finished;
+
+  std::deque<std::shared_ptr<job>> m_jobs;  // jobs that need more helpers
+  std::vector<std::thread> m_threads;
+  bool m_shutdown = false;
+
+  void worker_main();
+
+  void process_tasks(job& j);
+};
+
+
+struct vidio_row_slice
+{
+  int first_row;
+  int end_row;  // exclusive
+
+  int num_rows() const { return end_row - first_row; }
+};
+
+// Splits the rows of an image into at most num_slices slices of about equal size.
+// All slices except the last one have a multiple of 'alignment' rows (e.g. for subsampled chroma).
+std::vector<vidio_row_slice> split_into_row_slices(int height, int num_slices, int alignment);
+
+#endif //LIBVIDIO_THREAD_POOL_H
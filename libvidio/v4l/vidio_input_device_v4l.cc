@@ -21,12 +21,31 @@
 #include "libvidio/vidio_frame.h"
 #include "libvidio/v4l/vidio_v4l_raw_device.h"
 #include "libvidio/v4l/vidio_input_device_v4l.h"
-#include <dirent.h>
+#include "libvidio/v4l/vidio_v4l_reactor.h"
+#include "libvidio/v4l/vidio_v4l_device_registry.h"
+#include <cassert>
 #include <cstring>
 #include <algorithm>
 #include "libvidio/vidio_error.h"
 
 
+vidio_input_device_v4l::~vidio_input_device_v4l()
+{
+  if (m_capturing_thread.joinable() || m_uses_reactor) {
+    const vidio_error* err = stop_capturing();
+    delete err;
+  }
+
+  clear_frame_queue();
+
+  release_claimed_node();
+
+  for (auto* device : m_v4l_capture_devices) {
+    delete device;
+  }
+}
+
+
 std::string vidio_input_device_v4l::get_display_name() const
 {
   return m_v4l_capture_devices[0]->get_display_name();
@@ -47,39 +66,16 @@ bool vidio_input_device_v4l::matches_v4l_raw_device(const vidio_v4l_raw_device*
 
 vidio_result<std::vector<vidio_input_device_v4l*>> v4l_list_input_devices(const struct vidio_input_device_filter* filter)
 {
-  std::vector<vidio_v4l_raw_device*> rawdevices;
   std::vector<vidio_input_device_v4l*> devices;
 
-  DIR* d;
-  struct dirent* dir;
-  d = opendir("/dev");
-  if (d) {
-    while ((dir = readdir(d)) != nullptr) {
-      if (strncmp(dir->d_name, "video", 5) == 0) {
-        auto device = new vidio_v4l_raw_device();
-
-        auto result = device->query_device((std::string{"/dev/"} + dir->d_name).c_str());
-
-        if (result.error) {
-          return {result.error};
-        }
-        else if (result.value) {
-          {
-            if (device->has_video_capture_capability()) {
-              rawdevices.push_back(device);
-            }
-          }
-        }
-
-        // if we didn't add it to the list, delete it again
-        if (rawdevices.empty() || rawdevices.back() != device) {
-          delete device;
-        }
-      }
-    }
-    closedir(d);
+  // The registry already knows all devices and their formats. This does not access the devices.
+  auto rawdevicesResult = vidio_v4l_device_registry::get_instance().get_devices();
+  if (rawdevicesResult.error) {
+    return {rawdevicesResult.error};
   }
 
+  std::vector<vidio_v4l_raw_device*>& rawdevices = rawdevicesResult.value;
+
 
   // --- group v4l devices that operate on the same hardware
 
@@ -113,6 +109,11 @@ std::vector<vidio_video_format*> vidio_input_device_v4l::get_video_formats() con
   std::vector<vidio_video_format*> formats;
 
   for (auto dev : m_v4l_capture_devices) {
+    // Formats of nodes that are streaming to another input of this device cannot be used.
+    if (is_claimed_by_other_stream(dev)) {
+      continue;
+    }
+
     auto f = dev->get_video_formats();
     formats.insert(formats.end(), f.begin(), f.end());
   }
@@ -131,16 +132,43 @@ const vidio_error* vidio_input_device_v4l::set_capture_format(const vidio_video_
   }
 
   vidio_v4l_raw_device* capturedev = nullptr;
+  bool node_in_use = false;
   __u32 pixelformat = format_v4l->get_v4l2_pixel_format();
-  for (const auto& dev : m_v4l_capture_devices) {
-    if (dev->supports_pixel_format(pixelformat)) {
-      capturedev = dev;
-      break;
+
+  {
+    std::lock_guard<std::mutex> lock(m_node_group->mutex);
+
+    for (const auto& dev : m_v4l_capture_devices) {
+      if (dev->supports_pixel_format(pixelformat)) {
+        std::string node = dev->get_device_file();
+        if (node != m_claimed_node && m_node_group->claimed_nodes.count(node)) {
+          node_in_use = true;
+          continue;
+        }
+
+        capturedev = dev;
+        break;
+      }
+    }
+
+    if (!m_claimed_node.empty()) {
+      m_node_group->claimed_nodes.erase(m_claimed_node);
+      m_claimed_node.clear();
+    }
+
+    if (capturedev) {
+      m_claimed_node = capturedev->get_device_file();
+      m_node_group->claimed_nodes.insert(m_claimed_node);
     }
   }
 
   m_active_device = capturedev;
 
+  if (!capturedev && node_in_use) {
+    auto* err = new vidio_error(vidio_error_code_cannot_set_camera_format, "All devices with matching pixel format are used by other streams of this camera");
+    return err;
+  }
+
   if (!capturedev) {
     auto* err = new vidio_error(vidio_error_code_cannot_set_camera_format, "No device with matching pixel format found");
     return err;
@@ -166,7 +194,39 @@ const vidio_error* vidio_input_device_v4l::start_capturing()
     return new vidio_error(vidio_error_code_usage_error, "Usage error: cannot start capturing without setting capturing parameters.");
   }
 
-  m_capturing_thread = std::thread(&vidio_v4l_raw_device::start_capturing_blocking, m_active_device, this);
+  // A dmabuf is only valid while the driver does not refill the buffer, which requires zero-copy mode.
+  // User-pointer buffers are captured into the final frame memory, copying them would defeat their purpose.
+  m_active_device->set_zero_copy(m_zero_copy || m_export_dmabuf || m_userptr_mode);
+  m_active_device->set_export_dmabuf(m_export_dmabuf && !m_userptr_mode);
+  m_active_device->set_userptr_mode(m_userptr_mode, &m_userptr_allocator);
+  m_active_device->set_buffer_count(m_buffer_count, m_max_buffer_count);
+  m_frame_queue.resume_producer();
+  m_frame_queue.reset_end_of_stream();
+  m_active_device->reset_stop_signal();
+
+  auto& reactor = vidio_v4l_reactor::get_instance();
+  if (reactor.get_num_threads() > 0) {
+    // A reactor thread also serves other inputs. Blocking it on our full queue would stall them.
+    m_frame_queue.set_producer_may_block(false);
+
+    auto* err = m_active_device->setup_capturing(this);
+    if (err) {
+      return err;
+    }
+
+    err = reactor.add_device(m_active_device);
+    if (err) {
+      m_active_device->teardown_capturing();
+      return err;
+    }
+
+    m_uses_reactor = true;
+  }
+  else {
+    m_frame_queue.set_producer_may_block(true);
+    m_capturing_thread = std::thread(&vidio_v4l_raw_device::start_capturing_blocking, m_active_device, this);
+    m_uses_reactor = false;
+  }
 
   return nullptr;
 }
@@ -174,59 +234,125 @@ const vidio_error* vidio_input_device_v4l::start_capturing()
 
 const vidio_error* vidio_input_device_v4l::stop_capturing()
 {
+  if (m_uses_reactor) {
+    m_uses_reactor = false;
+
+    // Release a reactor thread that may be blocked in a full queue before waiting for it.
+    auto* err = m_active_device->stop_capturing();
+    m_frame_queue.interrupt_producer();
+
+    // After remove_device() returns, no reactor thread accesses the device anymore.
+    vidio_v4l_reactor::get_instance().remove_device(m_active_device);
+    m_active_device->teardown_capturing();
+
+    // Capturing may already have ended because of an error.
+    if (!m_frame_queue.is_end_of_stream()) {
+      send_callback_message(vidio_input_message_end_of_stream);
+    }
+
+    return err;
+  }
+
   auto* err = m_active_device->stop_capturing();
   if (err) {
     return err;
   }
 
+  m_frame_queue.interrupt_producer();
+
   if (m_capturing_thread.joinable()) {
     m_capturing_thread.join();
-    send_callback_message(vidio_input_message_end_of_stream);
+
+    if (!m_frame_queue.is_end_of_stream()) {
+      send_callback_message(vidio_input_message_end_of_stream);
+    }
   }
 
   return nullptr;
 }
 
 
-const vidio_frame* vidio_input_device_v4l::peek_next_frame() const
+void vidio_input_device_v4l::capturing_failed(const vidio_error* err)
 {
-  std::lock_guard<std::mutex> lock(m_queue_mutex);
+  // There is nobody to return the error to. The application sees the end of the stream.
+  delete err;
+  send_callback_message(vidio_input_message_end_of_stream);
+}
+
 
-  if (m_frame_queue.empty()) {
-    return nullptr;
+const vidio_error* vidio_input_device_v4l::reconfigure_capture(const vidio_video_format* requested_format,
+                                                               const vidio_video_format** out_actual_format)
+{
+  if (!m_uses_reactor && !m_capturing_thread.joinable()) {
+    return set_capture_format(requested_format, out_actual_format);
   }
-  else {
-    return m_frame_queue.front();
+
+  const auto* format_v4l = dynamic_cast<const vidio_video_format_v4l*>(requested_format);
+  if (!format_v4l) {
+    auto* err = new vidio_error(vidio_error_code_parameter_error, "Parameter error: format does not match V4L2 device");
+    return err;
   }
+
+  set_reconfigure_gap(-1, -1);
+
+  // The format can only be switched in place when it is captured by the same V4L2 device.
+  // Otherwise, or if the driver does not allow it, capturing is restarted.
+
+  if (m_active_device->supports_pixel_format(format_v4l->get_v4l2_pixel_format())) {
+    const vidio_video_format_v4l* actual_format = nullptr;
+    auto* err = m_active_device->reconfigure_capture(format_v4l, &actual_format);
+    if (!err) {
+      if (out_actual_format) {
+        *out_actual_format = actual_format->clone();
+      }
+
+      return nullptr;
+    }
+
+    delete err;
+  }
+
+  return vidio_input::reconfigure_capture(requested_format, out_actual_format);
 }
 
-void vidio_input_device_v4l::pop_next_frame()
+
+uint32_t vidio_input_device_v4l::get_buffer_count() const
 {
-  std::lock_guard<std::mutex> lock(m_queue_mutex);
-  delete m_frame_queue.front(); // TODO: we could reuse these frames
-  m_frame_queue.pop_front();
+  return m_active_device ? m_active_device->get_buffer_count() : 0;
 }
 
 
-void vidio_input_device_v4l::push_frame_into_queue(const vidio_frame* f)
+vidio_input_device_v4l* vidio_input_device_v4l::create_additional_stream() const
 {
-  bool overflow = false;
-
-  {
-    std::lock_guard<std::mutex> lock(m_queue_mutex);
+  auto* stream = new vidio_input_device_v4l(m_v4l_capture_devices[0]->copy_device_description());
 
-    if (m_frame_queue.size() < cMaxFrameQueueLength) {
-      m_frame_queue.push_back(f);
-    }
-    else {
-      overflow = true;
-    }
+  for (size_t i = 1; i < m_v4l_capture_devices.size(); i++) {
+    stream->add_v4l_raw_device(m_v4l_capture_devices[i]->copy_device_description());
   }
 
-  if (overflow)
-    send_callback_message(vidio_input_message_input_overflow);
-  else
-    send_callback_message(vidio_input_message_new_frame);
+  stream->m_node_group = m_node_group;
+
+  return stream;
+}
+
+
+bool vidio_input_device_v4l::is_claimed_by_other_stream(const vidio_v4l_raw_device* device) const
+{
+  std::lock_guard<std::mutex> lock(m_node_group->mutex);
+
+  std::string node = device->get_device_file();
+  return node != m_claimed_node && m_node_group->claimed_nodes.count(node) != 0;
+}
+
+
+void vidio_input_device_v4l::release_claimed_node()
+{
+  std::lock_guard<std::mutex> lock(m_node_group->mutex);
+
+  if (!m_claimed_node.empty()) {
+    m_node_group->claimed_nodes.erase(m_claimed_node);
+    m_claimed_node.clear();
+  }
 }
 
 
@@ -28,9 +28,9 @@
 #include <libvidio/vidio_input.h>
 #include <linux/videodev2.h>
 #include "vidio_video_format_v4l.h"
-#include <deque>
 #include <thread>
 #include <mutex>
+#include <set>
 
 #include "libvidio/vidio_error.h"
 
@@ -42,6 +42,8 @@ struct vidio_input_device_v4l : public vidio_input_device
 public:
   explicit vidio_input_device_v4l(vidio_v4l_raw_device* d) { m_v4l_capture_devices.emplace_back(d); }
 
+  ~vidio_input_device_v4l() override;
+
   std::string get_display_name() const override;
 
   vidio_input_source get_source() const override { return vidio_input_source_Video4Linux2; }
@@ -62,12 +64,36 @@ public:
 
   const vidio_error* stop_capturing() override;
 
-  const vidio_frame* peek_next_frame() const override;
+  // Called from the capturing thread when capturing ended because of an error. Signals the end of the stream.
+  void capturing_failed(const vidio_error* err);
 
-  void pop_next_frame() override;
+  const vidio_error* reconfigure_capture(const vidio_video_format* requested_format,
+                                         const vidio_video_format** out_actual_format) override;
 
   std::string serialize(vidio_serialization_format serialformat) const override;
 
+  void set_zero_copy(bool enable) { m_zero_copy = enable; }
+
+  void set_export_dmabuf(bool enable) { m_export_dmabuf = enable; }
+
+  void set_userptr_mode(bool enable, const vidio_v4l_userptr_allocator* allocator)
+  {
+    m_userptr_mode = enable;
+    m_userptr_allocator = allocator ? *allocator : vidio_v4l_userptr_allocator{};
+  }
+
+  void set_buffer_count(uint32_t count, uint32_t max_count)
+  {
+    m_buffer_count = count;
+    m_max_buffer_count = max_count;
+  }
+
+  uint32_t get_buffer_count() const;
+
+  // Creates another input for the same hardware, which can capture from a different device node at the same time
+  // (e.g. the H.264 node of a UVC camera in addition to its MJPEG node). It has its own queue and capturing thread.
+  vidio_input_device_v4l* create_additional_stream() const;
+
 #if WITH_JSON
 
   static vidio_input_device_v4l* find_matching_device(const std::vector<vidio_input*>& inputs, const nlohmann::json& json);
@@ -81,16 +107,36 @@ private:
 
   vidio_v4l_raw_device* m_active_device = nullptr;
 
+  bool m_zero_copy = false;
+  bool m_export_dmabuf = false;
+  bool m_userptr_mode = false;
+  vidio_v4l_userptr_allocator m_userptr_allocator{};
+
+  uint32_t m_buffer_count = 4;
+  uint32_t m_max_buffer_count = 0;
+
   std::thread m_capturing_thread;
 
-  std::deque<const vidio_frame*> m_frame_queue;
-  mutable std::mutex m_queue_mutex;
+  // Whether the current capture is served by the shared vidio_v4l_reactor instead of m_capturing_thread.
+  bool m_uses_reactor = false;
+
+  // Shared by an input and all inputs created from it with create_additional_stream().
+  // Each device node can only stream to one of them.
+  struct node_group
+  {
+    std::mutex mutex;
+    std::set<std::string> claimed_nodes;
+  };
+
+  std::shared_ptr<node_group> m_node_group = std::make_shared<node_group>();
+
+  // The device node that this input has claimed in m_node_group. Empty if none.
+  std::string m_claimed_node;
 
-  static const int cMaxFrameQueueLength = 20;
+  bool is_claimed_by_other_stream(const vidio_v4l_raw_device* device) const;
 
-  void push_frame_into_queue(const vidio_frame*);
+  void release_claimed_node();
 
-  friend struct vidio_v4l_raw_device; // to be able to access push_frame_into_queue()
 };
 
 
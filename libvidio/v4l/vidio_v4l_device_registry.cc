@@ -0,0 +1,367 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "vidio_v4l_device_registry.h"
+#include "vidio_v4l_raw_device.h"
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+
+static bool is_video_device_node(const char* name)
+{
+  return strncmp(name, "video", 5) == 0;
+}
+
+
+// Boards with ISPs or hardware codecs can have dozens of video nodes. Probing waits mostly for the devices,
+// so this may be larger than the number of CPU cores.
+static const size_t cMaxProbeThreads = 8;
+
+
+vidio_v4l_device_registry& vidio_v4l_device_registry::get_instance()
+{
+  static vidio_v4l_device_registry registry;
+  return registry;
+}
+
+
+vidio_v4l_device_registry::~vidio_v4l_device_registry()
+{
+  if (m_watch_thread.joinable()) {
+    uint64_t one = 1;
+    ssize_t n = ::write(m_wakeup_fd, &one, sizeof(one));
+    (void) n;
+
+    m_watch_thread.join();
+  }
+
+  if (m_inotify_fd != -1) {
+    ::close(m_inotify_fd);
+  }
+
+  if (m_wakeup_fd != -1) {
+    ::close(m_wakeup_fd);
+  }
+}
+
+
+vidio_result<std::vector<vidio_v4l_raw_device*>> vidio_v4l_device_registry::get_devices()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (!m_initialized || !m_watching) {
+    const vidio_error* err = initialize();
+    if (err) {
+      return err;
+    }
+  }
+
+  std::vector<vidio_v4l_raw_device*> devices;
+  for (const auto& [device_file, device] : m_devices) {
+    devices.push_back(device->copy_device_description());
+  }
+
+  return devices;
+}
+
+
+void vidio_v4l_device_registry::set_device_change_callback(vidio_device_change_callback callback, void* user_data)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_callback = callback;
+  m_callback_user_data = user_data;
+
+  // Start watching for changes, even if the devices have not been listed yet.
+  if (callback && !m_initialized) {
+    const vidio_error* err = initialize();
+    delete err;
+  }
+}
+
+
+const vidio_error* vidio_v4l_device_registry::initialize()
+{
+  // Watch before scanning, such that no device that appears during the scan is missed.
+  if (m_inotify_fd == -1) {
+    m_watching = start_watching();
+  }
+
+  const vidio_error* err = scan_devices();
+  if (err) {
+    return err;
+  }
+
+  m_initialized = true;
+
+  if (m_watching && !m_watch_thread.joinable()) {
+    m_watch_thread = std::thread(&vidio_v4l_device_registry::watch_thread_main, this);
+  }
+
+  return nullptr;
+}
+
+
+const vidio_error* vidio_v4l_device_registry::scan_devices()
+{
+  m_devices.clear();
+
+  std::vector<std::string> device_files;
+
+  DIR* d = opendir("/dev");
+  if (d) {
+    struct dirent* dir;
+    while ((dir = readdir(d)) != nullptr) {
+      if (is_video_device_node(dir->d_name)) {
+        device_files.emplace_back(std::string{"/dev/"} + dir->d_name);
+      }
+    }
+    closedir(d);
+  }
+
+  // Query the devices concurrently. Opening a device can block for a while (e.g. while a USB camera powers up),
+  // so querying them one after the other would scale with the number of cameras.
+  // A few threads (including this one) take the next device to probe from a shared index.
+
+  struct probe
+  {
+    std::unique_ptr<vidio_v4l_raw_device> device;
+    vidio_result<bool> result;
+  };
+
+  std::vector<probe> probes(device_files.size());
+  std::atomic<size_t> next_probe{0};
+
+  auto probe_devices = [&probes, &device_files, &next_probe]() {
+    for (;;) {
+      size_t i = next_probe.fetch_add(1);
+      if (i >= device_files.size()) {
+        return;
+      }
+
+      probes[i].device = std::make_unique<vidio_v4l_raw_device>();
+      probes[i].result = probes[i].device->query_device(device_files[i].c_str());
+    }
+  };
+
+  std::vector<std::thread> threads;
+  size_t num_threads = std::min(device_files.size(), cMaxProbeThreads);
+
+  for (size_t t = 1; t < num_threads; t++) {
+    try {
+      threads.emplace_back(probe_devices);
+    }
+    catch (const std::system_error&) {
+      // Continue with the threads that could be started. If there are none, this thread probes all devices.
+      break;
+    }
+  }
+
+  probe_devices();
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  const vidio_error* first_error = nullptr;
+
+  for (size_t i = 0; i < device_files.size(); i++) {
+    auto& p = probes[i];
+
+    if (p.result.error) {
+      // A single device that cannot be accessed should not hide all other devices.
+      if (!first_error) {
+        first_error = p.result.error;
+      }
+      else {
+        delete p.result.error;
+      }
+    }
+    else if (p.result.value && p.device->has_video_capture_capability()) {
+      m_devices[device_files[i]] = std::move(p.device);
+    }
+  }
+
+  if (first_error && m_devices.empty()) {
+    return first_error;
+  }
+
+  delete first_error;
+  return nullptr;
+}
+
+
+bool vidio_v4l_device_registry::start_watching()
+{
+  m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_inotify_fd == -1) {
+    return false;
+  }
+
+  // IN_ATTRIB: udev sets the access permissions after the device node has been created.
+  if (inotify_add_watch(m_inotify_fd, "/dev", IN_CREATE | IN_DELETE | IN_ATTRIB) == -1) {
+    ::close(m_inotify_fd);
+    m_inotify_fd = -1;
+    return false;
+  }
+
+  m_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_wakeup_fd == -1) {
+    ::close(m_inotify_fd);
+    m_inotify_fd = -1;
+    return false;
+  }
+
+  return true;
+}
+
+
+void vidio_v4l_device_registry::watch_thread_main()
+{
+  pollfd fds[2]{};
+  fds[0].fd = m_inotify_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = m_wakeup_fd;
+  fds[1].events = POLLIN;
+
+  alignas(inotify_event) char buffer[4096];
+
+  for (;;) {
+    int r = poll(fds, 2, -1);
+    if (r == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      return;
+    }
+
+    ssize_t len = ::read(m_inotify_fd, buffer, sizeof(buffer));
+    if (len <= 0) {
+      continue;
+    }
+
+    for (char* ptr = buffer; ptr < buffer + len;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(ptr);
+      ptr += sizeof(inotify_event) + event->len;
+
+      if (event->len == 0 || !is_video_device_node(event->name)) {
+        continue;
+      }
+
+      std::string device_file = std::string{"/dev/"} + event->name;
+
+      if (event->mask & IN_DELETE) {
+        device_node_removed(device_file);
+      }
+      else if (event->mask & (IN_CREATE | IN_ATTRIB)) {
+        device_node_added(device_file);
+      }
+    }
+  }
+}
+
+
+void vidio_v4l_device_registry::device_node_added(const std::string& device_file)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_devices.find(device_file) != m_devices.end()) {
+      return;
+    }
+  }
+
+  // Query without holding the lock, this can take a while.
+  // If the device is not accessible yet, we will try again on the next IN_ATTRIB event.
+
+  auto device = std::make_unique<vidio_v4l_raw_device>();
+  auto result = device->query_device(device_file.c_str());
+  if (result.error) {
+    delete result.error;
+    return;
+  }
+
+  if (!result.value || !device->has_video_capture_capability()) {
+    return;
+  }
+
+  const vidio_v4l_raw_device* added_device;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_devices.find(device_file) != m_devices.end()) {
+      return;
+    }
+
+    added_device = device.get();
+    m_devices[device_file] = std::move(device);
+  }
+
+  // The device is only removed from the watch thread itself, so it remains valid during the callback.
+  notify(vidio_device_change_added, added_device);
+}
+
+
+void vidio_v4l_device_registry::device_node_removed(const std::string& device_file)
+{
+  std::unique_ptr<vidio_v4l_raw_device> device;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto iter = m_devices.find(device_file);
+    if (iter == m_devices.end()) {
+      return;
+    }
+
+    device = std::move(iter->second);
+    m_devices.erase(iter);
+  }
+
+  notify(vidio_device_change_removed, device.get());
+}
+
+
+void vidio_v4l_device_registry::notify(vidio_device_change change, const vidio_v4l_raw_device* device)
+{
+  vidio_device_change_callback callback;
+  void* user_data;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    callback = m_callback;
+    user_data = m_callback_user_data;
+  }
+
+  if (callback) {
+    callback(change, device->get_device_file().c_str(), device->get_display_name().c_str(), user_data);
+  }
+}
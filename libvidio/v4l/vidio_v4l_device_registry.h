@@ -0,0 +1,89 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVIDIO_VIDIO_V4L_DEVICE_REGISTRY_H
+#define LIBVIDIO_VIDIO_V4L_DEVICE_REGISTRY_H
+
+#include <libvidio/vidio.h>
+#include <libvidio/vidio_error.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct vidio_v4l_raw_device;
+
+
+// Keeps the list of V4L2 capture devices with their capabilities and formats, such that listing the devices
+// does not have to query all devices each time.
+// The list is populated on first use and then kept up to date by watching /dev with inotify.
+class vidio_v4l_device_registry
+{
+public:
+  static vidio_v4l_device_registry& get_instance();
+
+  // Returns new device objects (owned by the caller) for all capture devices, without accessing the devices.
+  vidio_result<std::vector<vidio_v4l_raw_device*>> get_devices();
+
+  void set_device_change_callback(vidio_device_change_callback callback, void* user_data);
+
+private:
+  vidio_v4l_device_registry() = default;
+
+  ~vidio_v4l_device_registry();
+
+  std::mutex m_mutex;
+
+  bool m_initialized = false;
+
+  // Without inotify, we cannot know whether the list is still current and have to scan each time.
+  bool m_watching = false;
+
+  // Only devices with video capture capability, indexed by the device file.
+  std::map<std::string, std::unique_ptr<vidio_v4l_raw_device>> m_devices;
+
+  vidio_device_change_callback m_callback = nullptr;
+  void* m_callback_user_data = nullptr;
+
+  int m_inotify_fd = -1;
+  int m_wakeup_fd = -1;  // eventfd to terminate the watch thread
+  std::thread m_watch_thread;
+
+  // Called with m_mutex held.
+  const vidio_error* initialize();
+
+  const vidio_error* scan_devices();
+
+  bool start_watching();
+
+  void watch_thread_main();
+
+  // Called from the watch thread.
+  void device_node_added(const std::string& device_file);
+
+  void device_node_removed(const std::string& device_file);
+
+  void notify(vidio_device_change change, const vidio_v4l_raw_device* device);
+};
+
+#endif //LIBVIDIO_VIDIO_V4L_DEVICE_REGISTRY_H
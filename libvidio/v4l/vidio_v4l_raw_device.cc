@@ -27,10 +27,22 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <limits>
+
+
+// Buffer sizes come from 32 bit V4L2 fields. Frame planes and the bitstream parsers use int.
+static int clamp_to_int(size_t size)
+{
+  return (int) std::min(size, (size_t) std::numeric_limits<int>::max());
+}
 
 
 // Scan H264 Annex B bitstream for IDR NAL units (NAL type 5).
@@ -89,9 +101,27 @@ static bool h265_detect_keyframe(const uint8_t* data, int size)
 }
 
 
+vidio_v4l_raw_device::vidio_v4l_raw_device()
+    : m_format_list(std::make_shared<format_list>()),
+      m_device_link(std::make_shared<device_link>())
+{
+  m_device_link->device = this;
+}
+
+
 vidio_v4l_raw_device::~vidio_v4l_raw_device()
 {
+  {
+    std::lock_guard<std::mutex> lock(m_device_link->mutex);
+    m_device_link->device = nullptr;
+  }
+
   close();
+
+  if (m_wakeup_fd != -1) {
+    ::close(m_wakeup_fd);
+  }
+
   delete m_capture_format;
 }
 
@@ -125,12 +155,20 @@ vidio_result<bool> vidio_v4l_raw_device::query_device(const char* filename)
 
   m_device_file = filename;
 
+  // Prefer the single-planar API. Some devices (e.g. ISPs and capture bridges) only support the multi-planar one.
+  if (m_caps.device_caps & V4L2_CAP_VIDEO_CAPTURE) {
+    m_buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  }
+  else {
+    m_buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+  }
+
   if (has_video_capture_capability()) {
 
     // --- check whether driver supports time/frame
 
     v4l2_streamparm streamparm{};
-    streamparm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    streamparm.type = m_buf_type;
     ret = ioctl(m_fd, VIDIOC_G_PARM, &streamparm);
     if (ret == -1) {
       ::close(m_fd);
@@ -144,68 +182,112 @@ vidio_result<bool> vidio_v4l_raw_device::query_device(const char* filename)
     m_supports_framerate = !!(streamparm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME);
 
     // --- list supported formats
+    // The frame sizes and intervals are enumerated later, when they are needed.
 
-    auto formatsResult = list_v4l_formats(V4L2_BUF_TYPE_VIDEO_CAPTURE);
+    auto formatsResult = list_v4l_formats(m_fd, m_buf_type);
     if (formatsResult.error) {
+      ::close(m_fd);
+      m_fd = -1;
+
       return formatsResult.error;
     }
 
-    const auto& formats = formatsResult.value;
-    for (auto f : formats) {
+    for (auto f : formatsResult.value) {
       format_v4l format;
       format.m_fmtdesc = f;
+      m_format_list->formats.emplace_back(format);
+    }
+  }
 
-      auto frmsizesResult = list_v4l_framesizes(f.pixelformat);
-      if (frmsizesResult.error) {
-        return frmsizesResult.error;
-      }
+  ::close(m_fd);
+  m_fd = -1;
 
-      const auto& frmsizes = frmsizesResult.value;
-      for (auto s : frmsizes) {
-        framesize_v4l fsize;
-        fsize.m_framesize = s;
+  return true;
+}
 
-        if (m_supports_framerate) {
-          vidio_result<std::vector<v4l2_frmivalenum>> frmintervalsResult;
 
-          if (s.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
-            frmintervalsResult = list_v4l_frameintervals(f.pixelformat, s.discrete.width, s.discrete.height);
-          }
-          else {
-            frmintervalsResult = list_v4l_frameintervals(f.pixelformat, s.stepwise.max_width, s.stepwise.max_height);
-          }
+const vidio_error* vidio_v4l_raw_device::query_framesizes() const
+{
+  // Use a separate file descriptor. The device may be capturing or closed.
+  int fd = ::open(m_device_file.c_str(), O_RDWR | O_NONBLOCK);
+  if (fd == -1) {
+    auto* err = new vidio_error(vidio_error_code_cannot_open_camera, "Cannot open camera ({0})");
+    err->set_arg(0, m_device_file);
+    err->set_reason(vidio_error::from_errno());
+    return err;
+  }
 
-          if (frmintervalsResult.error) {
-            return frmintervalsResult.error;
-          }
+  std::vector<format_v4l> formats = m_format_list->formats;
 
-          fsize.m_frameintervals = frmintervalsResult.value;
+  for (auto& format : formats) {
+    __u32 pixelformat = format.m_fmtdesc.pixelformat;
+
+    auto frmsizesResult = list_v4l_framesizes(fd, pixelformat);
+    if (frmsizesResult.error) {
+      ::close(fd);
+      return frmsizesResult.error;
+    }
+
+    format.m_framesizes.clear();
+
+    for (auto s : frmsizesResult.value) {
+      framesize_v4l fsize;
+      fsize.m_framesize = s;
+
+      if (m_supports_framerate) {
+        vidio_result<std::vector<v4l2_frmivalenum>> frmintervalsResult;
+
+        if (s.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+          frmintervalsResult = list_v4l_frameintervals(fd, pixelformat, s.discrete.width, s.discrete.height);
+        }
+        else {
+          frmintervalsResult = list_v4l_frameintervals(fd, pixelformat, s.stepwise.max_width, s.stepwise.max_height);
         }
 
-        format.m_framesizes.emplace_back(fsize);
+        if (frmintervalsResult.error) {
+          ::close(fd);
+          return frmintervalsResult.error;
+        }
+
+        fsize.m_frameintervals = frmintervalsResult.value;
       }
 
-      m_formats.emplace_back(format);
+      format.m_framesizes.emplace_back(fsize);
     }
   }
 
-  ::close(m_fd);
-  m_fd = -1;
+  ::close(fd);
 
-  return true;
+  m_format_list->formats = std::move(formats);
+  m_format_list->framesizes_queried = true;
+
+  return nullptr;
 }
 
 
-vidio_result<std::vector<v4l2_fmtdesc>> vidio_v4l_raw_device::list_v4l_formats(__u32 type) const
+vidio_v4l_raw_device* vidio_v4l_raw_device::copy_device_description() const
+{
+  auto* device = new vidio_v4l_raw_device();
+  device->m_device_file = m_device_file;
+  device->m_buf_type = m_buf_type;
+  device->m_supports_framerate = m_supports_framerate;
+  device->m_caps = m_caps;
+  device->m_format_list = m_format_list;
+
+  return device;
+}
+
+
+vidio_result<std::vector<v4l2_fmtdesc>> vidio_v4l_raw_device::list_v4l_formats(int fd, __u32 type)
 {
   std::vector<v4l2_fmtdesc> fmts;
 
-  assert(m_fd >= 0);
+  assert(fd >= 0);
 
   v4l2_fmtdesc fmtdesc{};
   fmtdesc.type = type;
   for (fmtdesc.index = 0;; fmtdesc.index++) {
-    int ret = ioctl(m_fd, VIDIOC_ENUM_FMT, &fmtdesc);
+    int ret = ioctl(fd, VIDIOC_ENUM_FMT, &fmtdesc);
     if (ret < 0) {
       if (errno == EINVAL) {
         // we reached the end of the enumeration
@@ -224,16 +306,16 @@ vidio_result<std::vector<v4l2_fmtdesc>> vidio_v4l_raw_device::list_v4l_formats(_
 }
 
 
-vidio_result<std::vector<v4l2_frmsizeenum>> vidio_v4l_raw_device::list_v4l_framesizes(__u32 pixel_type) const
+vidio_result<std::vector<v4l2_frmsizeenum>> vidio_v4l_raw_device::list_v4l_framesizes(int fd, __u32 pixel_type)
 {
   std::vector<v4l2_frmsizeenum> frmsizes;
 
-  assert(m_fd >= 0);
+  assert(fd >= 0);
 
   v4l2_frmsizeenum framesize{};
   framesize.pixel_format = pixel_type;
   for (framesize.index = 0;; framesize.index++) {
-    int ret = ioctl(m_fd, VIDIOC_ENUM_FRAMESIZES, &framesize);
+    int ret = ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &framesize);
     if (ret < 0) {
       if (errno == EINVAL) {
         // we reached the end of the enumeration
@@ -278,11 +360,11 @@ vidio_result<std::vector<v4l2_frmsizeenum>> vidio_v4l_raw_device::list_v4l_frame
 
 
 vidio_result<std::vector<v4l2_frmivalenum>>
-vidio_v4l_raw_device::list_v4l_frameintervals(__u32 pixel_type, __u32 width, __u32 height) const
+vidio_v4l_raw_device::list_v4l_frameintervals(int fd, __u32 pixel_type, __u32 width, __u32 height)
 {
   std::vector<v4l2_frmivalenum> frmivals;
 
-  assert(m_fd >= 0);
+  assert(fd >= 0);
 
   v4l2_frmivalenum frameinterval{};
   frameinterval.pixel_format = pixel_type;
@@ -290,7 +372,7 @@ vidio_v4l_raw_device::list_v4l_frameintervals(__u32 pixel_type, __u32 width, __u
   frameinterval.height = height;
 
   for (frameinterval.index = 0;; frameinterval.index++) {
-    int ret = ioctl(m_fd, VIDIOC_ENUM_FRAMEINTERVALS, &frameinterval);
+    int ret = ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &frameinterval);
     if (ret < 0) {
       if (errno == EINVAL) {
         // we reached the end of the enumeration
@@ -347,7 +429,19 @@ std::vector<vidio_video_format_v4l*> vidio_v4l_raw_device::get_video_formats() c
 {
   std::vector<vidio_video_format_v4l*> formats;
 
-  for (const auto& f : m_formats) {
+  std::lock_guard<std::mutex> lock(m_format_list->mutex);
+
+  if (!m_format_list->framesizes_queried) {
+    // When the device cannot be queried now (e.g. because it was unplugged), we return no formats
+    // and try again on the next call.
+    const vidio_error* err = query_framesizes();
+    if (err) {
+      delete err;
+      return formats;
+    }
+  }
+
+  for (const auto& f : m_format_list->formats) {
 
     for (const auto& r : f.m_framesizes) {
       uint32_t w, h;
@@ -391,7 +485,9 @@ std::vector<vidio_video_format_v4l*> vidio_v4l_raw_device::get_video_formats() c
 
 bool vidio_v4l_raw_device::supports_pixel_format(__u32 pixelformat) const
 {
-  return std::any_of(m_formats.begin(), m_formats.end(),
+  std::lock_guard<std::mutex> lock(m_format_list->mutex);
+
+  return std::any_of(m_format_list->formats.begin(), m_format_list->formats.end(),
                      [pixelformat](const auto& f) {
                        return f.m_fmtdesc.pixelformat == pixelformat;
                      });
@@ -409,6 +505,23 @@ static vidio_pixel_format v4l2_pixelformat_to_vidio_format(__u32 v4l_format)
       return vidio_pixel_format_H264;
     case V4L2_PIX_FMT_HEVC:
       return vidio_pixel_format_H265;
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12M:
+      return vidio_pixel_format_YUV420_NV12;
+    case V4L2_PIX_FMT_NV16:
+    case V4L2_PIX_FMT_NV16M:
+      return vidio_pixel_format_YUV422_NV16;
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_NV21M:
+      return vidio_pixel_format_YUV420_NV21;
+    case V4L2_PIX_FMT_UYVY:
+      return vidio_pixel_format_YUV422_UYVY;
+    case V4L2_PIX_FMT_GREY:
+      return vidio_pixel_format_GREY8;
+    case V4L2_PIX_FMT_BGR24:
+      return vidio_pixel_format_BGR8;
+    case V4L2_PIX_FMT_SRGGB8:
+      return vidio_pixel_format_RGGB8;
 
     default:
       return vidio_pixel_format_undefined;
@@ -427,43 +540,124 @@ const vidio_error* vidio_v4l_raw_device::set_capture_format(const vidio_video_fo
 
   assert(m_fd >= 0);
 
+  // Create the stop signal before the capturing thread is started, such that an early stop_capturing() can use it.
+  auto* err = create_wakeup_fd();
+  if (err) {
+    return err;
+  }
+
   delete m_capture_format;
   m_capture_format = dynamic_cast<vidio_video_format_v4l*>(format_v4l->clone());
   assert(m_capture_format);
 
-  int ret;
+  if (-1 == try_set_format(format_v4l, m_capture)) {
+    auto* fmt_err = new vidio_error(vidio_error_code_cannot_set_camera_format, "Cannot set camera format (VIDIOC_S_FMT)");
+    fmt_err->set_reason(vidio_error::from_errno());
+    return fmt_err;
+  }
+
+  return set_framerate(format_v4l);
+}
+
+
+// Drivers may leave ycbcr_enc and quantization at their defaults. These are then defined by the colorspace.
+static void v4l2_colorimetry(__u32 colorspace, __u32 ycbcr_enc, __u32 quantization,
+                             vidio_color_matrix& out_matrix, vidio_color_range& out_range)
+{
+  if (ycbcr_enc == V4L2_YCBCR_ENC_DEFAULT) {
+    ycbcr_enc = V4L2_MAP_YCBCR_ENC_DEFAULT(colorspace);
+  }
+
+  if (quantization == V4L2_QUANTIZATION_DEFAULT) {
+    quantization = V4L2_MAP_QUANTIZATION_DEFAULT(false, colorspace, ycbcr_enc);
+  }
+
+  switch (ycbcr_enc) {
+    case V4L2_YCBCR_ENC_601:
+    case V4L2_YCBCR_ENC_XV601:
+      out_matrix = vidio_color_matrix_bt601;
+      break;
+    case V4L2_YCBCR_ENC_709:
+    case V4L2_YCBCR_ENC_XV709:
+      out_matrix = vidio_color_matrix_bt709;
+      break;
+    case V4L2_YCBCR_ENC_BT2020:
+    case V4L2_YCBCR_ENC_BT2020_CONST_LUM:
+      out_matrix = vidio_color_matrix_bt2020;
+      break;
+    default:
+      out_matrix = vidio_color_matrix_unknown;
+      break;
+  }
+
+  out_range = (quantization == V4L2_QUANTIZATION_FULL_RANGE) ? vidio_color_range_full : vidio_color_range_limited;
+}
+
 
+int vidio_v4l_raw_device::try_set_format(const vidio_video_format_v4l* format_v4l, capture_format& out_capture) const
+{
   v4l2_format fmt{};
-  fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-  fmt.fmt.pix.width = format_v4l->get_width();
-  fmt.fmt.pix.height = format_v4l->get_height();
-  fmt.fmt.pix.pixelformat = format_v4l->get_v4l2_pixel_format();
-  fmt.fmt.pix.field = V4L2_FIELD_ANY;
+  fmt.type = m_buf_type;
+  if (is_multiplanar()) {
+    fmt.fmt.pix_mp.width = format_v4l->get_width();
+    fmt.fmt.pix_mp.height = format_v4l->get_height();
+    fmt.fmt.pix_mp.pixelformat = format_v4l->get_v4l2_pixel_format();
+    fmt.fmt.pix_mp.field = V4L2_FIELD_ANY;
+  }
+  else {
+    fmt.fmt.pix.width = format_v4l->get_width();
+    fmt.fmt.pix.height = format_v4l->get_height();
+    fmt.fmt.pix.pixelformat = format_v4l->get_v4l2_pixel_format();
+    fmt.fmt.pix.field = V4L2_FIELD_ANY;
+  }
 
-  ret = ioctl(m_fd, VIDIOC_S_FMT, &fmt);
+  int ret = ioctl(m_fd, VIDIOC_S_FMT, &fmt);
   if (ret == -1) {
-    auto* err = new vidio_error(vidio_error_code_cannot_set_camera_format, "Cannot set camera format (VIDIOC_S_FMT)");
-    err->set_reason(vidio_error::from_errno());
-    return err;
+    return ret;
   }
 
+  capture_format capture;
 
   // TODO: can we assume that we got the requested format, or do we have to check what we really got?
-  m_capture_width = format_v4l->get_width();
-  m_capture_height = format_v4l->get_height();
-  m_capture_pixel_format = format_v4l->get_v4l2_pixel_format();
-  m_capture_vidio_pixel_format = v4l2_pixelformat_to_vidio_format(m_capture_pixel_format);
+  capture.width = format_v4l->get_width();
+  capture.height = format_v4l->get_height();
+
+  if (is_multiplanar()) {
+    capture.num_planes = std::min<uint32_t>(fmt.fmt.pix_mp.num_planes, VIDEO_MAX_PLANES);
+    for (uint32_t i = 0; i < capture.num_planes; i++) {
+      capture.bytesperline[i] = fmt.fmt.pix_mp.plane_fmt[i].bytesperline;
+      capture.sizeimage[i] = fmt.fmt.pix_mp.plane_fmt[i].sizeimage;
+    }
+
+    v4l2_colorimetry(fmt.fmt.pix_mp.colorspace, fmt.fmt.pix_mp.ycbcr_enc, fmt.fmt.pix_mp.quantization,
+                     capture.color_matrix, capture.color_range);
+  }
+  else {
+    capture.num_planes = 1;
+    capture.bytesperline[0] = fmt.fmt.pix.bytesperline;
+    capture.sizeimage[0] = fmt.fmt.pix.sizeimage;
 
+    v4l2_colorimetry(fmt.fmt.pix.colorspace, fmt.fmt.pix.ycbcr_enc, fmt.fmt.pix.quantization,
+                     capture.color_matrix, capture.color_range);
+  }
+  capture.pixel_format = format_v4l->get_v4l2_pixel_format();
+  capture.vidio_format = v4l2_pixelformat_to_vidio_format(capture.pixel_format);
+
+  out_capture = capture;
+
+  return ret;
+}
 
-  // --- set framerate
 
+const vidio_error* vidio_v4l_raw_device::set_framerate(const vidio_video_format_v4l* format_v4l)
+{
   if (m_supports_framerate) {
     v4l2_streamparm param{};
-    param.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    param.type = m_buf_type;
     param.parm.capture.timeperframe.numerator = format_v4l->get_framerate().denominator;
     param.parm.capture.timeperframe.denominator = format_v4l->get_framerate().numerator;
 
-    ret = ioctl(m_fd, VIDIOC_S_PARM, &param);
+    int ret = ioctl(m_fd, VIDIOC_S_PARM, &param);
     if (ret == -1) {
       auto* err = new vidio_error(vidio_error_code_cannot_set_camera_format, "Cannot set camera format (VIDIOC_S_PARAM)");
       err->set_reason(vidio_error::from_errno());
@@ -486,18 +680,65 @@ static std::string fourcc_to_string(uint32_t cc)
 }
 
 
-const vidio_error* vidio_v4l_raw_device::start_capturing_blocking(vidio_input_device_v4l* input_device)
+const vidio_error* vidio_v4l_raw_device::setup_capturing(vidio_input_device_v4l* input_device)
 {
   assert(m_fd != -1);
   assert(input_device != nullptr);
 
+  m_input_device = input_device;
+
   // --- request buffers
 
+  auto buffersResult = request_buffers();
+  if (buffersResult.error) {
+    return buffersResult.error;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex_loop_control);
+    m_buffers = buffersResult.value;
+  }
+
+  // --- queue all buffers
+
+  for (size_t i = 0; i < m_buffers->buffers.size(); i++) {
+    if (-1 == queue_buffer(*m_buffers, (__u32) i)) {
+      auto* err = new vidio_error(vidio_error_code_cannot_alloc_capturing_buffers, "Cannot queue buffer (VIDIOC_QBUF index={0})");
+      err->set_arg(0, std::to_string(i));
+      err->set_reason(vidio_error::from_errno());
+      return err;
+    }
+  }
+
+  // --- switch on streaming
+
+  auto type = (v4l2_buf_type) m_buf_type;
+  if (-1 == ioctl(m_fd, VIDIOC_STREAMON, &type)) {
+    auto* err = new vidio_error(vidio_error_code_cannot_start_capturing, "Cannot start capturing (VIDIOC_STREAMON)");
+    err->set_reason(vidio_error::from_errno());
+    return err;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex_loop_control);
+    m_capturing_active = true;
+    m_capture_generation++;
+    m_sequence_valid = false;
+    m_timestamp_valid = false;
+    m_reconfigure_pending = false;
+  }
+
+  return nullptr;
+}
+
+
+vidio_result<std::shared_ptr<vidio_v4l_raw_device::buffer_set>> vidio_v4l_raw_device::request_buffers()
+{
   v4l2_requestbuffers req{};
 
-  req.count = 4;
-  req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-  req.memory = V4L2_MEMORY_MMAP;
+  req.count = m_buffer_count;
+  req.type = m_buf_type;
+  req.memory = m_memory;
 
   int ret;
 
@@ -514,242 +755,912 @@ const vidio_error* vidio_v4l_raw_device::start_capturing_blocking(vidio_input_de
     return err;
   }
 
-  m_buffers.resize(req.count);
+  auto buffers = std::make_shared<buffer_set>();
+  buffers->memory = m_memory;
+  buffers->allocator = m_userptr_allocator;
 
   for (__u32 i = 0; i < req.count; i++) {
-    v4l2_buffer buf{};
+    auto* err = add_capture_buffer(i, *buffers);
+    if (err) {
+      return err;
+    }
+  }
+
+  return buffers;
+}
 
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    buf.index = i;
 
-    if (-1 == ioctl(m_fd, VIDIOC_QUERYBUF, &buf)) {
-      auto* err = new vidio_error(vidio_error_code_cannot_alloc_capturing_buffers, "Cannot query capturing buffers (VIDIOC_QUERYBUF index={0})");
-      err->set_arg(0, std::to_string(req.count));
-      err->set_reason(vidio_error::from_errno());
+void vidio_v4l_raw_device::release_driver_buffers(__u32 memory)
+{
+  v4l2_requestbuffers req{};
+  req.count = 0;
+  req.type = m_buf_type;
+  req.memory = memory;
+
+  ioctl(m_fd, VIDIOC_REQBUFS, &req);
+}
+
+
+const vidio_error* vidio_v4l_raw_device::add_capture_buffer(__u32 index, buffer_set& buffers)
+{
+  if (buffers.memory == V4L2_MEMORY_USERPTR) {
+    return allocate_userptr_buffer(buffers);
+  }
+  else {
+    return map_capture_buffer(index, buffers);
+  }
+}
+
+
+const vidio_error* vidio_v4l_raw_device::allocate_userptr_buffer(buffer_set& buffers)
+{
+  // The driver may require page-aligned buffers with a size that is a multiple of the page size.
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+
+  // The buffer is added before all of its planes are allocated, so that the buffer_set releases them on error.
+  buffers.buffers.emplace_back();
+  buffer& user_buffer = buffers.buffers.back();
+
+  for (uint32_t p = 0; p < m_capture.num_planes; p++) {
+    size_t size = (m_capture.sizeimage[p] + page_size - 1) / page_size * page_size;
+
+    buffer_plane& plane = user_buffer.planes[p];
+    plane.length = size;
+
+    if (buffers.allocator.allocate) {
+      plane.start = buffers.allocator.allocate(size, buffers.allocator.user_data);
+    }
+    else {
+      plane.start = aligned_alloc(page_size, size);
+    }
+
+    if (plane.start == nullptr) {
+      auto* err = new vidio_error(vidio_error_code_cannot_alloc_capturing_buffers, "Cannot allocate capturing buffer memory (size={0})");
+      err->set_arg(0, std::to_string(size));
       return err;
     }
 
-    m_buffers[i].length = buf.length;
-    m_buffers[i].start =
+    user_buffer.num_planes = p + 1;
+  }
+
+  return nullptr;
+}
+
+
+int vidio_v4l_raw_device::queue_buffer(const buffer_set& buffers, __u32 index)
+{
+  const buffer& buffer = buffers.buffers[index];
+
+  v4l2_buffer buf{};
+  buf.type = m_buf_type;
+  buf.memory = buffers.memory;
+  buf.index = index;
+
+  v4l2_plane planes[VIDEO_MAX_PLANES]{};
+
+  if (is_multiplanar()) {
+    buf.m.planes = planes;
+    buf.length = buffer.num_planes;
+
+    if (buffers.memory == V4L2_MEMORY_USERPTR) {
+      for (uint32_t p = 0; p < buffer.num_planes; p++) {
+        planes[p].m.userptr = (unsigned long) buffer.planes[p].start;
+        planes[p].length = (__u32) buffer.planes[p].length;
+      }
+    }
+  }
+  else if (buffers.memory == V4L2_MEMORY_USERPTR) {
+    buf.m.userptr = (unsigned long) buffer.planes[0].start;
+    buf.length = (__u32) buffer.planes[0].length;
+  }
+
+  return ioctl(m_fd, VIDIOC_QBUF, &buf);
+}
+
+
+const vidio_error* vidio_v4l_raw_device::map_capture_buffer(__u32 index, buffer_set& buffers)
+{
+  v4l2_buffer buf{};
+  v4l2_plane planes[VIDEO_MAX_PLANES]{};
+
+  buf.type = m_buf_type;
+  buf.memory = V4L2_MEMORY_MMAP;
+  buf.index = index;
+
+  if (is_multiplanar()) {
+    buf.m.planes = planes;
+    buf.length = VIDEO_MAX_PLANES;
+  }
+
+  if (-1 == ioctl(m_fd, VIDIOC_QUERYBUF, &buf)) {
+    auto* err = new vidio_error(vidio_error_code_cannot_alloc_capturing_buffers, "Cannot query capturing buffers (VIDIOC_QUERYBUF index={0})");
+    err->set_arg(0, std::to_string(index));
+    err->set_reason(vidio_error::from_errno());
+    return err;
+  }
+
+  uint32_t num_planes = is_multiplanar() ? std::min<uint32_t>(buf.length, VIDEO_MAX_PLANES) : 1;
+
+  // The buffer is added before all of its planes are mapped, so that the buffer_set releases them on error.
+  buffers.buffers.emplace_back();
+  buffer& mapped_buffer = buffers.buffers.back();
+
+  for (uint32_t p = 0; p < num_planes; p++) {
+    size_t length = is_multiplanar() ? planes[p].length : buf.length;
+    off_t offset = is_multiplanar() ? planes[p].m.mem_offset : buf.m.offset;
+
+    buffer_plane& plane = mapped_buffer.planes[p];
+    plane.length = length;
+    plane.start =
         mmap(nullptr /* start anywhere */,
-             buf.length,
+             length,
              PROT_READ | PROT_WRITE /* required */,
              MAP_SHARED /* recommended */,
-             m_fd, buf.m.offset);
+             m_fd, offset);
 
-    if (MAP_FAILED == m_buffers[i].start) {
+    if (MAP_FAILED == plane.start) {
       auto* err = new vidio_error(vidio_error_code_cannot_alloc_capturing_buffers, "Cannot map capturing buffer memory (mmap index={0})");
-      err->set_arg(0, std::to_string(req.count));
+      err->set_arg(0, std::to_string(index));
       err->set_reason(vidio_error::from_errno());
+      plane.start = nullptr;
       return err;
     }
+
+    mapped_buffer.num_planes = p + 1;
+
+    if (m_export_dmabuf) {
+      v4l2_exportbuffer expbuf{};
+      expbuf.type = m_buf_type;
+      expbuf.index = index;
+      expbuf.plane = p;
+      expbuf.flags = O_RDONLY | O_CLOEXEC;
+
+      if (-1 == ioctl(m_fd, VIDIOC_EXPBUF, &expbuf)) {
+        auto* err = new vidio_error(vidio_error_code_cannot_alloc_capturing_buffers, "Cannot export capturing buffer as dmabuf (VIDIOC_EXPBUF index={0})");
+        err->set_arg(0, std::to_string(index));
+        err->set_reason(vidio_error::from_errno());
+        return err;
+      }
+
+      plane.dmabuf_fd = expbuf.fd;
+    }
   }
 
-  // --- queue all buffers
+  return nullptr;
+}
+
 
-  for (size_t i = 0; i < m_buffers.size(); i++) {
-    v4l2_buffer buf{};
+void vidio_v4l_raw_device::grow_buffers()
+{
+  // Called with m_mutex_loop_control held, while streaming.
 
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    buf.index = (__u32) i;
+  v4l2_create_buffers create{};
+  create.count = 1;
+  create.memory = m_buffers->memory;
+  create.format.type = m_buf_type;
 
-    if (-1 == ioctl(m_fd, VIDIOC_QBUF, &buf)) {
-      auto* err = new vidio_error(vidio_error_code_cannot_alloc_capturing_buffers, "Cannot queue buffer (VIDIOC_QBUF index={0})");
-      err->set_arg(0, std::to_string(req.count));
+  if (-1 == ioctl(m_fd, VIDIOC_G_FMT, &create.format)) {
+    return;
+  }
+
+  // Not all drivers support adding buffers while streaming. Then we simply stay with the current number.
+  if (-1 == ioctl(m_fd, VIDIOC_CREATE_BUFS, &create) || create.count == 0) {
+    m_max_buffer_count = 0;
+    return;
+  }
+
+  // Indices of new buffers follow the existing ones. Only the thread calling capture_next_frame() accesses the buffer list.
+  assert(create.index == m_buffers->buffers.size());
+
+  const vidio_error* err = add_capture_buffer(create.index, *m_buffers);
+  if (err) {
+    delete err;
+    return;
+  }
+
+  queue_buffer(*m_buffers, create.index);
+}
+
+
+const vidio_error* vidio_v4l_raw_device::create_wakeup_fd()
+{
+  std::unique_lock<std::mutex> lock(m_mutex_loop_control);
+
+  if (m_wakeup_fd == -1) {
+    m_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeup_fd == -1) {
+      auto* err = new vidio_error(vidio_error_code_cannot_start_capturing, "Cannot create eventfd for V4L2 capturing");
       err->set_reason(vidio_error::from_errno());
       return err;
     }
   }
 
-  // --- switch on streaming
+  return nullptr;
+}
 
-  v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-  if (-1 == ioctl(m_fd, VIDIOC_STREAMON, &type)) {
-    auto* err = new vidio_error(vidio_error_code_cannot_start_capturing, "Cannot start capturing (VIDIOC_STREAMON)");
-    err->set_reason(vidio_error::from_errno());
+
+void vidio_v4l_raw_device::drain_wakeup_fd()
+{
+  if (m_wakeup_fd != -1) {
+    uint64_t value;
+    ssize_t n = ::read(m_wakeup_fd, &value, sizeof(value));
+    (void) n;
+  }
+}
+
+
+const vidio_error* vidio_v4l_raw_device::start_capturing_blocking(vidio_input_device_v4l* input_device)
+{
+  const vidio_error* err = create_wakeup_fd();
+  if (err) {
     return err;
   }
 
-  m_capturing_active = true;
+  err = setup_capturing(input_device);
+  if (err) {
+    drain_wakeup_fd();
+    return err;
+  }
 
-  while (true || m_capturing_active) {
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(m_fd, &fds);
+  // Wait for a frame or for the stop signal. Without a timeout, stop_capturing() takes effect immediately
+  // instead of only after the next frame arrived.
 
-    /* Timeout. */
-    struct timeval tv{};
-    tv.tv_sec = 2;
-    tv.tv_usec = 0;
+  pollfd fds[2]{};
+  fds[0].fd = m_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = m_wakeup_fd;
+  fds[1].events = POLLIN;
 
-    if (m_capturing_active) {
-      int r = select(m_fd + 1, &fds, nullptr, nullptr, &tv);
-      if (r == -1) {
-        if (errno == EINTR)
-          continue;
-        else {
-          auto* err = new vidio_error(vidio_error_code_error_while_capturing, "Error while waiting for next frame");
-          err->set_reason(vidio_error::from_errno());
-          return err;
-        }
+  while (m_capturing_active) {
+    int r = poll(fds, 2, -1);
+    if (r == -1) {
+      if (errno == EINTR)
+        continue;
+      else {
+        auto* poll_err = new vidio_error(vidio_error_code_error_while_capturing, "Error while waiting for next frame");
+        poll_err->set_reason(vidio_error::from_errno());
+        err = poll_err;
+        break;
       }
     }
 
-    // get frame
+    if (fds[1].revents & POLLIN) {
+      break;
+    }
 
-    v4l2_buffer buf{};
+    if (fds[0].revents & (POLLERR | POLLHUP)) {
+      // POLLERR is also signalled while reconfigure_capture() has switched off streaming.
+      // The device is only gone when it cannot be queried anymore.
+      v4l2_capability caps{};
+      if (-1 == ioctl(m_fd, VIDIOC_QUERYCAP, &caps)) {
+        err = new vidio_error(vidio_error_code_error_while_capturing, "V4L2 device was disconnected");
+        break;
+      }
+    }
 
-    m_mutex_loop_control.lock();
+    auto result = capture_next_frame();
+    if (result.error) {
+      err = result.error;
+      break;
+    }
+  }
 
-    if (m_capturing_active) {
-      buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-      buf.memory = V4L2_MEMORY_MMAP;
+  teardown_capturing();
 
-      ret = ioctl(m_fd, VIDIOC_DQBUF, &buf);
-      m_mutex_loop_control.unlock();
+  if (err) {
+    capturing_failed(err);
+  }
 
-      if (ret == -1) {
-        auto* err = new vidio_error(vidio_error_code_error_while_capturing, "Cannot unqueue buffer (VIDIOC_DQBUF index={0})");
-        err->set_arg(0, std::to_string(req.count));
-        err->set_reason(vidio_error::from_errno());
-        return err;
+  return nullptr;
+}
+
+
+static vidio_clock_domain v4l2_timestamp_clock_domain(__u32 flags, uint64_t timestamp_us, uint64_t monotonic_now_us)
+{
+  switch (flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) {
+    case V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC:
+      return vidio_clock_domain_monotonic;
+
+    case V4L2_BUF_FLAG_TIMESTAMP_COPY:
+      // Copied from an output buffer (memory-to-memory devices). We do not know where it came from.
+      return vidio_clock_domain_unknown;
+
+    default: {
+      // Drivers from before Linux 3.9 do not tell. They use either the monotonic or the wall clock.
+      // The timestamp is much closer to the current time of its own clock than to that of the other one.
+      auto realtime_now = std::chrono::system_clock::now().time_since_epoch();
+      auto realtime_now_us = (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(realtime_now).count();
+
+      auto distance = [](uint64_t a, uint64_t b) { return a > b ? a - b : b - a; };
+
+      if (distance(timestamp_us, monotonic_now_us) < distance(timestamp_us, realtime_now_us)) {
+        return vidio_clock_domain_monotonic;
+      }
+      else {
+        return vidio_clock_domain_realtime;
       }
     }
-    else {
-      m_mutex_loop_control.unlock();
-      break;
-    }
+  }
+}
 
-    const buffer& buffer = m_buffers[buf.index];
 
-    // TODO: alternatively to copying the data into the vidio_frame, we could also offer a mode in which
-    //  the vidio_frame only wraps the v4l2 buffer and this is passed directly to the client.
-    //  The client code must be very quick, but it would eliminate one copy.
-    //  Easiest implementation would be when the "add_plane()" functions had a mode switch (copy or wrap).
+vidio_result<bool> vidio_v4l_raw_device::capture_next_frame()
+{
+  // get frame
 
-    auto* frame = new vidio_frame();
-    switch (m_capture_pixel_format) {
-      case V4L2_PIX_FMT_YUYV:
-        frame->set_format(vidio_pixel_format_YUV422_YUYV, m_capture_width, m_capture_height);
-        frame->add_raw_plane(vidio_color_channel_interleaved, 16);
-        frame->copy_raw_plane(vidio_color_channel_interleaved, buffer.start, buf.bytesused);
-        break;
-      case V4L2_PIX_FMT_MJPEG:
-        frame->set_format(vidio_pixel_format_MJPEG, m_capture_width, m_capture_height);
-        frame->add_compressed_plane(vidio_color_channel_compressed, vidio_channel_format_compressed_MJPEG, 8,
-                                    (const uint8_t*) buffer.start, buf.bytesused,
-                                    m_capture_width, m_capture_height);
-        break;
-      case V4L2_PIX_FMT_H264:
-      case V4L2_PIX_FMT_H264_MVC:
-      case V4L2_PIX_FMT_H264_NO_SC:
-      case V4L2_PIX_FMT_H264_SLICE:
-        frame->set_format(vidio_pixel_format_H264, m_capture_width, m_capture_height);
-        frame->add_compressed_plane(vidio_color_channel_compressed, vidio_channel_format_compressed_H264, 8,
-                                    (const uint8_t*) buffer.start, buf.bytesused,
-                                    m_capture_width, m_capture_height);
-        break;
-      case V4L2_PIX_FMT_HEVC:
-        frame->set_format(vidio_pixel_format_H265, m_capture_width, m_capture_height);
-        frame->add_compressed_plane(vidio_color_channel_compressed, vidio_channel_format_compressed_H265, 8,
-                                    (const uint8_t*) buffer.start, buf.bytesused,
-                                    m_capture_width, m_capture_height);
-        break;
-      case V4L2_PIX_FMT_SRGGB8:
-        frame->set_format(vidio_pixel_format_RGGB8, m_capture_width, m_capture_height);
-        frame->add_raw_plane(vidio_color_channel_interleaved, 8);
-        frame->copy_raw_plane(vidio_color_channel_interleaved, (const uint8_t*) buffer.start, buf.bytesused);
-        break;
-      default: {
-        auto* err = new vidio_error(vidio_error_code_internal_error, "Unsupported V4L2 pixel format ({0})");
-        err->set_arg(0, fourcc_to_string(m_capture_pixel_format));
-        return err;
-        break;
-      }
+  v4l2_buffer buf{};
+  v4l2_plane planes[VIDEO_MAX_PLANES]{};
+  uint32_t generation;
+  std::shared_ptr<buffer_set> buffers;
+  capture_format fmt;
+  uint64_t dequeue_timestamp;
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex_loop_control);
+
+    if (!m_capturing_active) {
+      return false;
     }
 
-    uint64_t timestamp = buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec;
-    frame->set_timestamp_us(timestamp);
+    buf.type = m_buf_type;
+    buf.memory = m_buffers->memory;
 
-    // Set keyframe flag for compressed formats
-    if (m_capture_vidio_pixel_format == vidio_pixel_format_MJPEG) {
-      frame->set_keyframe(true);  // MJPEG is intra-frame only
+    if (is_multiplanar()) {
+      buf.m.planes = planes;
+      buf.length = VIDEO_MAX_PLANES;
     }
-    else if (m_capture_vidio_pixel_format == vidio_pixel_format_H264) {
-      bool is_keyframe = (buf.flags & V4L2_BUF_FLAG_KEYFRAME) != 0;
-      // Some V4L2 drivers don't set the keyframe flag; detect IDR via NAL parsing
-      if (!is_keyframe) {
-        is_keyframe = h264_detect_keyframe((const uint8_t*) buffer.start, buf.bytesused);
+
+    if (-1 == ioctl(m_fd, VIDIOC_DQBUF, &buf)) {
+      // The device is opened non-blocking. There may be no filled buffer yet.
+      if (errno == EAGAIN) {
+        return false;
       }
-      frame->set_keyframe(is_keyframe);
+
+      auto* err = new vidio_error(vidio_error_code_error_while_capturing, "Cannot unqueue buffer (VIDIOC_DQBUF)");
+      err->set_reason(vidio_error::from_errno());
+      return err;
     }
-    else if (m_capture_vidio_pixel_format == vidio_pixel_format_H265) {
-      bool is_keyframe = (buf.flags & V4L2_BUF_FLAG_KEYFRAME) != 0;
-      if (!is_keyframe) {
-        is_keyframe = h265_detect_keyframe((const uint8_t*) buffer.start, buf.bytesused);
+
+    dequeue_timestamp = vidio_input::get_monotonic_time_us();
+
+    generation = m_capture_generation;
+    buffers = m_buffers;
+    fmt = m_capture;
+
+    buffers->buffers[buf.index].held = true;
+
+    measure_reconfigure_gap(buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec);
+
+    // A gap in the sequence numbers means that the driver dropped frames, e.g. because it had no free buffer to fill.
+    // In adaptive mode, add another buffer to the queue to absorb stalls of the consumer.
+
+    if (m_sequence_valid && buf.sequence > m_last_sequence + 1) {
+      m_input_device->add_driver_dropped_frames(buf.sequence - m_last_sequence - 1);
+
+      if (m_buffers->buffers.size() < m_max_buffer_count) {
+        grow_buffers();
       }
-      frame->set_keyframe(is_keyframe);
     }
 
-    input_device->push_frame_into_queue(frame);
+    m_last_sequence = buf.sequence;
+    m_sequence_valid = true;
+  }
 
-    // --- re-queue buffer
+  const buffer& buffer = buffers->buffers[buf.index];
 
-    if (-1 == ioctl(m_fd, VIDIOC_QBUF, &buf)) {
-      auto* err = new vidio_error(vidio_error_code_error_while_capturing, "Cannot queue buffer (VIDIOC_QBUF index={0})");
-      err->set_arg(0, std::to_string(req.count));
-      err->set_reason(vidio_error::from_errno());
-      return err;
+  // Start and size of the captured data in each memory plane.
+
+  const uint8_t* data[VIDEO_MAX_PLANES]{};
+  size_t data_size[VIDEO_MAX_PLANES]{};
+
+  if (is_multiplanar()) {
+    for (uint32_t p = 0; p < buffer.num_planes; p++) {
+      uint32_t offset = std::min(planes[p].data_offset, planes[p].bytesused);
+      data[p] = (const uint8_t*) buffer.planes[p].start + offset;
+      data_size[p] = planes[p].bytesused - offset;
     }
   }
+  else {
+    data[0] = (const uint8_t*) buffer.planes[0].start;
+    data_size[0] = buf.bytesused;
+  }
 
-  // release capturing buffers
+  // In zero-copy mode, the vidio_frame only wraps the V4L2 buffer. The buffer is re-queued when the frame
+  // and all of its clones are released.
 
-  for (auto& buffer : m_buffers) {
-    if (munmap(buffer.start, buffer.length) == -1) {
-      auto* err = new vidio_error(vidio_error_code_cannot_free_capturing_buffers, "Cannot unmap buffer (munmap)");
-      err->set_reason(vidio_error::from_errno());
+  std::shared_ptr<void> buffer_owner;
+  if (m_zero_copy) {
+    buffer_owner = std::make_shared<buffer_reference>(buffer_reference{m_device_link, buffers, buf.index, generation});
+  }
+
+  vidio_frame_pool& frame_pool = m_input_device->get_frame_pool();
+  vidio_frame* frame = nullptr;
+
+  const int w = (int) fmt.width;
+  const int h = (int) fmt.height;
+  const vidio_channel_format pixels = vidio_channel_format_pixels;
+
+  switch (fmt.pixel_format) {
+    case V4L2_PIX_FMT_YUYV:
+      frame = frame_pool.acquire_frame(vidio_pixel_format_YUV422_YUYV, w, h,
+                                       {{vidio_color_channel_interleaved, pixels, w, h, 16}});
+      add_raw_buffer_plane(frame, vidio_color_channel_interleaved, data[0], data_size[0],
+                           fmt.width, fmt.height, 16, fmt.get_stride(2), buffer_owner);
+      break;
+    case V4L2_PIX_FMT_UYVY:
+      frame = frame_pool.acquire_frame(vidio_pixel_format_YUV422_UYVY, w, h,
+                                       {{vidio_color_channel_interleaved, pixels, w, h, 16}});
+      add_raw_buffer_plane(frame, vidio_color_channel_interleaved, data[0], data_size[0],
+                           fmt.width, fmt.height, 16, fmt.get_stride(2), buffer_owner);
+      break;
+    case V4L2_PIX_FMT_GREY:
+      frame = frame_pool.acquire_frame(vidio_pixel_format_GREY8, w, h,
+                                       {{vidio_color_channel_Y, pixels, w, h, 8}});
+      add_raw_buffer_plane(frame, vidio_color_channel_Y, data[0], data_size[0],
+                           fmt.width, fmt.height, 8, fmt.get_stride(1), buffer_owner);
+      break;
+    case V4L2_PIX_FMT_BGR24:
+      frame = frame_pool.acquire_frame(vidio_pixel_format_BGR8, w, h,
+                                       {{vidio_color_channel_interleaved, pixels, w, h, 24}});
+      add_raw_buffer_plane(frame, vidio_color_channel_interleaved, data[0], data_size[0],
+                           fmt.width, fmt.height, 24, fmt.get_stride(3), buffer_owner);
+      break;
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12M:
+    case V4L2_PIX_FMT_NV16:
+    case V4L2_PIX_FMT_NV16M:
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_NV21M: {
+      bool is_420 = (fmt.pixel_format != V4L2_PIX_FMT_NV16 && fmt.pixel_format != V4L2_PIX_FMT_NV16M);
+      uint32_t chroma_height = is_420 ? (fmt.height + 1) / 2 : fmt.height;
+      int y_stride = fmt.get_stride(1);
+
+      // NV12/NV16/NV21: the UV plane directly follows the Y plane in the same memory plane.
+      // NV12M/NV16M/NV21M: the UV plane is in a separate memory plane with its own stride.
+      const uint8_t* uv_data;
+      size_t uv_size;
+      int uv_stride;
+      if (buffer.num_planes >= 2) {
+        uv_data = data[1];
+        uv_size = data_size[1];
+        uv_stride = fmt.get_stride(1, 1);
+      }
+      else {
+        size_t y_size = std::min(size_t(y_stride) * fmt.height, data_size[0]);
+        uv_data = data[0] + y_size;
+        uv_size = data_size[0] - y_size;
+        uv_stride = y_stride;
+      }
+
+      frame = frame_pool.acquire_frame(v4l2_pixelformat_to_vidio_format(fmt.pixel_format), w, h,
+                                       {{vidio_color_channel_Y, pixels, w, h, 8},
+                                        {vidio_color_channel_UV, pixels, (w + 1) / 2, (int) chroma_height, 16}});
+      add_raw_buffer_plane(frame, vidio_color_channel_Y, data[0], data_size[0],
+                           fmt.width, fmt.height, 8, y_stride, buffer_owner);
+      add_raw_buffer_plane(frame, vidio_color_channel_UV, uv_data, uv_size,
+                           (fmt.width + 1) / 2, chroma_height, 16, uv_stride, buffer_owner);
+      break;
+    }
+    case V4L2_PIX_FMT_MJPEG:
+      frame = frame_pool.acquire_frame(vidio_pixel_format_MJPEG, w, h,
+                                       {{vidio_color_channel_compressed, vidio_channel_format_compressed_MJPEG, w, h, 8}});
+      add_compressed_buffer_plane(frame, vidio_channel_format_compressed_MJPEG, data[0], data_size[0],
+                                  fmt.width, fmt.height, buffer_owner);
+      break;
+    case V4L2_PIX_FMT_H264:
+    case V4L2_PIX_FMT_H264_MVC:
+    case V4L2_PIX_FMT_H264_NO_SC:
+    case V4L2_PIX_FMT_H264_SLICE:
+      frame = frame_pool.acquire_frame(vidio_pixel_format_H264, w, h,
+                                       {{vidio_color_channel_compressed, vidio_channel_format_compressed_H264, w, h, 8}});
+      add_compressed_buffer_plane(frame, vidio_channel_format_compressed_H264, data[0], data_size[0],
+                                  fmt.width, fmt.height, buffer_owner);
+      break;
+    case V4L2_PIX_FMT_HEVC:
+      frame = frame_pool.acquire_frame(vidio_pixel_format_H265, w, h,
+                                       {{vidio_color_channel_compressed, vidio_channel_format_compressed_H265, w, h, 8}});
+      add_compressed_buffer_plane(frame, vidio_channel_format_compressed_H265, data[0], data_size[0],
+                                  fmt.width, fmt.height, buffer_owner);
+      break;
+    case V4L2_PIX_FMT_SRGGB8:
+      frame = frame_pool.acquire_frame(vidio_pixel_format_RGGB8, w, h,
+                                       {{vidio_color_channel_interleaved, pixels, w, h, 8}});
+      add_raw_buffer_plane(frame, vidio_color_channel_interleaved, data[0], data_size[0],
+                           fmt.width, fmt.height, 8, fmt.get_stride(1), buffer_owner);
+      break;
+    default: {
+      auto* err = new vidio_error(vidio_error_code_internal_error, "Unsupported V4L2 pixel format ({0})");
+      err->set_arg(0, fourcc_to_string(fmt.pixel_format));
       return err;
+      break;
+    }
+  }
+
+  // A frame can only carry a single dmabuf. Buffers with several memory planes are not exported to the frame.
+  if (buffer_owner && buffer.num_planes == 1 && buffer.planes[0].dmabuf_fd != -1) {
+    size_t offset = data[0] - (const uint8_t*) buffer.planes[0].start;
+    frame->set_dmabuf(buffer.planes[0].dmabuf_fd, offset, data_size[0], buffer_owner);
+  }
+
+  uint64_t timestamp = buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec;
+  frame->set_timestamp_us(timestamp);
+  frame->set_clock_domain(v4l2_timestamp_clock_domain(buf.flags, timestamp, dequeue_timestamp));
+  frame->set_timestamp_source((buf.flags & V4L2_BUF_FLAG_TSTAMP_SRC_MASK) == V4L2_BUF_FLAG_TSTAMP_SRC_SOE ?
+                              vidio_timestamp_source_start_of_exposure : vidio_timestamp_source_end_of_frame);
+  frame->set_dequeue_timestamp_us(dequeue_timestamp);
+  frame->set_sequence_number(buf.sequence);
+  frame->set_colorimetry(fmt.color_matrix, fmt.color_range);
+
+  // Set keyframe flag for compressed formats
+  if (fmt.vidio_format == vidio_pixel_format_MJPEG) {
+    frame->set_keyframe(true);  // MJPEG is intra-frame only
+  }
+  else if (fmt.vidio_format == vidio_pixel_format_H264) {
+    bool is_keyframe = (buf.flags & V4L2_BUF_FLAG_KEYFRAME) != 0;
+    // Some V4L2 drivers don't set the keyframe flag; detect IDR via NAL parsing
+    if (!is_keyframe) {
+      is_keyframe = h264_detect_keyframe(data[0], clamp_to_int(data_size[0]));
+    }
+    frame->set_keyframe(is_keyframe);
+  }
+  else if (fmt.vidio_format == vidio_pixel_format_H265) {
+    bool is_keyframe = (buf.flags & V4L2_BUF_FLAG_KEYFRAME) != 0;
+    if (!is_keyframe) {
+      is_keyframe = h265_detect_keyframe(data[0], clamp_to_int(data_size[0]));
+    }
+    frame->set_keyframe(is_keyframe);
+  }
+
+  m_input_device->push_frame_into_queue(frame);
+
+  if (m_zero_copy) {
+    return true;
+  }
+
+  // --- re-queue buffer
+
+  if (-1 == requeue_buffer(*buffers, buf.index, generation)) {
+    auto* err = new vidio_error(vidio_error_code_error_while_capturing, "Cannot queue buffer (VIDIOC_QBUF index={0})");
+    err->set_arg(0, std::to_string(buf.index));
+    err->set_reason(vidio_error::from_errno());
+    return err;
+  }
+
+  return true;
+}
+
+
+void vidio_v4l_raw_device::capturing_failed(const vidio_error* err)
+{
+  m_input_device->capturing_failed(err);
+}
+
+
+void vidio_v4l_raw_device::teardown_capturing()
+{
+  // When capturing ended because of an error, streaming is still on.
+  const vidio_error* err = stop_capturing();
+  delete err;
+
+  // release capturing buffers (they are unmapped as soon as no zero-copy frame references them anymore)
+
+  __u32 memory = V4L2_MEMORY_MMAP;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex_loop_control);
+    if (m_buffers) {
+      memory = m_buffers->memory;
     }
+    m_buffers.reset();
   }
 
-  m_buffers.clear();
+  // release buffers (otherwise, S_FMT would return EBUSY).
+  // This fails if zero-copy frames still reference buffers. The driver releases them when the last mapping is gone.
+
+  release_driver_buffers(memory);
+
+  // The stop signal has been consumed. Reset it for the next capture.
+  drain_wakeup_fd();
 
   if (strncmp((const char*)(m_caps.card), "Creative WebCam Live! Motion", 32)==0) {
     // This camera needs to be closed after capturing. Otherwise it won't accept a different S_FMT.
     close();
   }
+}
+
+
+const vidio_error* vidio_v4l_raw_device::reconfigure_capture(const vidio_video_format_v4l* format_v4l,
+                                                              const vidio_video_format_v4l** out_format)
+{
+  // Holding the lock keeps the capturing loop out of capture_next_frame() until streaming is switched on again.
+  // The capturing thread (or reactor) itself keeps running.
+  std::unique_lock<std::mutex> lock(m_mutex_loop_control);
+
+  if (!m_capturing_active) {
+    return new vidio_error(vidio_error_code_usage_error, "Usage error: cannot reconfigure capturing when not capturing.");
+  }
+
+  // When anything fails from here on, the capturing loop ends and the caller has to restart capturing.
+  auto fail = [this](const vidio_error* err) {
+    m_capturing_active = false;
+    return err;
+  };
+
+  // STREAMOFF returns all buffers from the driver queue. Buffers still held by frames remain held.
+
+  auto type = (v4l2_buf_type) m_buf_type;
+  if (-1 == ioctl(m_fd, VIDIOC_STREAMOFF, &type)) {
+    auto* err = new vidio_error(vidio_error_code_cannot_stop_capturing, "Cannot stop capturing (V4L2 STREAMOFF)");
+    err->set_reason(vidio_error::from_errno());
+    return fail(err);
+  }
+
+  // Some drivers accept a new format while the buffers are allocated, most return EBUSY.
+
+  capture_format new_capture;
+  bool driver_buffers_released = false;
+
+  int ret = try_set_format(format_v4l, new_capture);
+  if (ret == -1 && errno == EBUSY) {
+    release_driver_buffers(m_buffers->memory);
+    driver_buffers_released = true;
+
+    ret = try_set_format(format_v4l, new_capture);
+  }
+
+  if (ret == -1) {
+    auto* err = new vidio_error(vidio_error_code_cannot_set_camera_format, "Cannot set camera format (VIDIOC_S_FMT)");
+    err->set_reason(vidio_error::from_errno());
+    return fail(err);
+  }
+
+  m_capture = new_capture;
+
+  delete m_capture_format;
+  m_capture_format = dynamic_cast<vidio_video_format_v4l*>(format_v4l->clone());
+  assert(m_capture_format);
+
+  const vidio_error* err = set_framerate(format_v4l);
+  if (err) {
+    return fail(err);
+  }
+
+  // --- keep the buffers if possible
+
+  bool reuse_buffers = buffers_fit_format(*m_buffers, m_capture);
+
+  if (reuse_buffers && driver_buffers_released) {
+    // Mapped buffers are gone with REQBUFS(0), but our own memory can be handed to the driver again.
+    reuse_buffers = false;
+
+    if (m_buffers->memory == V4L2_MEMORY_USERPTR) {
+      v4l2_requestbuffers req{};
+      req.count = (__u32) m_buffers->buffers.size();
+      req.type = m_buf_type;
+      req.memory = V4L2_MEMORY_USERPTR;
+
+      if (ioctl(m_fd, VIDIOC_REQBUFS, &req) == 0 && req.count == m_buffers->buffers.size()) {
+        reuse_buffers = true;
+      }
+      else {
+        release_driver_buffers(V4L2_MEMORY_USERPTR);
+      }
+    }
+  }
+
+  if (!reuse_buffers) {
+    if (!driver_buffers_released) {
+      release_driver_buffers(m_buffers->memory);
+    }
+
+    auto buffersResult = request_buffers();
+    if (buffersResult.error) {
+      return fail(buffersResult.error);
+    }
+
+    // Frames that still reference the old buffers must not queue them into the new set.
+    m_buffers = buffersResult.value;
+    m_capture_generation++;
+  }
+
+  // --- queue all free buffers and switch on streaming again
+
+  for (size_t i = 0; i < m_buffers->buffers.size(); i++) {
+    if (!m_buffers->buffers[i].held && -1 == queue_buffer(*m_buffers, (__u32) i)) {
+      auto* qbuf_err = new vidio_error(vidio_error_code_cannot_alloc_capturing_buffers, "Cannot queue buffer (VIDIOC_QBUF index={0})");
+      qbuf_err->set_arg(0, std::to_string(i));
+      qbuf_err->set_reason(vidio_error::from_errno());
+      return fail(qbuf_err);
+    }
+  }
+
+  if (-1 == ioctl(m_fd, VIDIOC_STREAMON, &type)) {
+    auto* streamon_err = new vidio_error(vidio_error_code_cannot_start_capturing, "Cannot start capturing (VIDIOC_STREAMON)");
+    streamon_err->set_reason(vidio_error::from_errno());
+    return fail(streamon_err);
+  }
+
+  // The driver restarts the sequence numbers.
+  m_sequence_valid = false;
+  m_reconfigure_pending = true;
+
+  if (out_format) {
+    *out_format = m_capture_format;
+  }
 
   return nullptr;
 }
 
 
-const vidio_error* vidio_v4l_raw_device::stop_capturing()
+bool vidio_v4l_raw_device::buffers_fit_format(const buffer_set& buffers, const capture_format& format) const
 {
-  if (m_capturing_active) {
-    std::unique_lock<std::mutex> lock(m_mutex_loop_control);
+  if (buffers.buffers.empty()) {
+    return false;
+  }
 
-    m_capturing_active = false;
+  for (const auto& buffer : buffers.buffers) {
+    if (buffer.num_planes != format.num_planes) {
+      return false;
+    }
 
-    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (-1 == ioctl(m_fd, VIDIOC_STREAMOFF, &type)) {
-      auto* err = new vidio_error(vidio_error_code_cannot_stop_capturing, "Cannot stop capturing (V4L2 STREAMOFF)");
-      err->set_reason(vidio_error::from_errno());
-      return err;
+    for (uint32_t p = 0; p < buffer.num_planes; p++) {
+      if (format.sizeimage[p] == 0 || buffer.planes[p].length < format.sizeimage[p]) {
+        return false;
+      }
     }
+  }
 
+  return true;
+}
 
-    // release buffers (otherwise, S_FMT would return EBUSY
 
-    v4l2_requestbuffers req{};
-    req.count = 0;
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    req.memory = V4L2_MEMORY_MMAP;
+void vidio_v4l_raw_device::measure_reconfigure_gap(uint64_t timestamp_us)
+{
+  // Called with m_mutex_loop_control held, for each dequeued buffer.
+
+  if (m_reconfigure_pending) {
+    m_reconfigure_pending = false;
+
+    if (m_timestamp_valid && timestamp_us > m_last_timestamp_us) {
+      uint64_t gap_us = timestamp_us - m_last_timestamp_us;
+
+      // Count the missing frames in frame periods of the new format. If it has no fixed framerate,
+      // use the period measured before the switch.
+      uint64_t period_us = m_frame_interval_us;
+      if (m_capture_format->has_fixed_framerate()) {
+        vidio_fraction framerate = m_capture_format->get_framerate();
+        if (framerate.numerator > 0) {
+          period_us = uint64_t(1000000) * framerate.denominator / framerate.numerator;
+        }
+      }
+
+      int missed_frames = -1;
+      if (period_us > 0) {
+        missed_frames = std::max(0, (int) ((gap_us + period_us / 2) / period_us) - 1);
+      }
 
-    if (-1 == ioctl(m_fd, VIDIOC_REQBUFS, &req)) {
-      auto* err = new vidio_error(vidio_error_code_cannot_free_capturing_buffers, "Cannot free capturing buffers (V4L2 set REQBUFS count to 0)");
+      m_input_device->set_reconfigure_gap((int64_t) gap_us, missed_frames);
+    }
+
+    // Do not take the gap as a frame interval.
+    m_last_timestamp_us = timestamp_us;
+    m_timestamp_valid = true;
+    return;
+  }
+
+  if (m_timestamp_valid && timestamp_us > m_last_timestamp_us) {
+    m_frame_interval_us = timestamp_us - m_last_timestamp_us;
+  }
+
+  m_last_timestamp_us = timestamp_us;
+  m_timestamp_valid = true;
+}
+
+
+void vidio_v4l_raw_device::add_compressed_buffer_plane(vidio_frame* frame, vidio_channel_format format,
+                                                       const uint8_t* data, size_t size, uint32_t w, uint32_t h,
+                                                       const std::shared_ptr<void>& buffer_owner)
+{
+  int plane_size = clamp_to_int(size);
+
+  if (m_zero_copy) {
+    frame->add_external_compressed_plane(vidio_color_channel_compressed, format, 8,
+                                         (uint8_t*) data, plane_size,
+                                         (int) w, (int) h, buffer_owner);
+  }
+  else {
+    frame->add_compressed_plane(vidio_color_channel_compressed, format, 8,
+                                data, plane_size,
+                                (int) w, (int) h);
+  }
+}
+
+
+void vidio_v4l_raw_device::add_raw_buffer_plane(vidio_frame* frame, vidio_color_channel channel,
+                                                const uint8_t* data, size_t size, int w, int h, int bpp, int stride,
+                                                const std::shared_ptr<void>& buffer_owner)
+{
+  if (m_zero_copy) {
+    frame->add_external_raw_plane(channel, (uint8_t*) data, w, h, bpp, stride, buffer_owner);
+  }
+  else {
+    frame->add_raw_plane(channel, w, h, bpp);
+    frame->copy_raw_plane(channel, data, size, stride);
+  }
+}
+
+
+vidio_v4l_raw_device::buffer_reference::~buffer_reference()
+{
+  std::lock_guard<std::mutex> lock(link->mutex);
+
+  // There is no way to report an error from here. If this fails, the driver has one buffer less to fill.
+  if (link->device) {
+    link->device->requeue_buffer(*buffers, index, generation);
+  }
+}
+
+
+int vidio_v4l_raw_device::requeue_buffer(buffer_set& buffers, __u32 index, uint32_t generation)
+{
+  std::unique_lock<std::mutex> lock(m_mutex_loop_control);
+
+  buffers.buffers[index].held = false;
+
+  // Capturing was stopped or restarted since the frame was captured. The buffer does not belong to the driver queue anymore.
+  if (!m_capturing_active || generation != m_capture_generation) {
+    return 0;
+  }
+
+  return queue_buffer(buffers, index);
+}
+
+
+vidio_v4l_raw_device::buffer_set::~buffer_set()
+{
+  for (auto& buffer : buffers) {
+    for (uint32_t p = 0; p < buffer.num_planes; p++) {
+      buffer_plane& plane = buffer.planes[p];
+
+      if (memory == V4L2_MEMORY_USERPTR) {
+        if (allocator.release) {
+          allocator.release(plane.start, plane.length, allocator.user_data);
+        }
+        else {
+          free(plane.start);
+        }
+
+        continue;
+      }
+
+      munmap(plane.start, plane.length);
+
+      if (plane.dmabuf_fd != -1) {
+        ::close(plane.dmabuf_fd);
+      }
+    }
+  }
+}
+
+
+const vidio_error* vidio_v4l_raw_device::stop_capturing()
+{
+  std::unique_lock<std::mutex> lock(m_mutex_loop_control);
+
+  // Signal the capturing loop even when capturing has not been switched on yet,
+  // so that a stop that overtakes setup_capturing() is not lost.
+  if (m_wakeup_fd != -1) {
+    uint64_t one = 1;
+    ssize_t n = ::write(m_wakeup_fd, &one, sizeof(one));
+    (void) n;
+  }
+
+  if (m_capturing_active) {
+    m_capturing_active = false;
+
+    auto type = (v4l2_buf_type) m_buf_type;
+    if (-1 == ioctl(m_fd, VIDIOC_STREAMOFF, &type)) {
+      auto* err = new vidio_error(vidio_error_code_cannot_stop_capturing, "Cannot stop capturing (V4L2 STREAMOFF)");
       err->set_reason(vidio_error::from_errno());
       return err;
     }
@@ -762,7 +1673,8 @@ const vidio_error* vidio_v4l_raw_device::stop_capturing()
 const vidio_error* vidio_v4l_raw_device::open()
 {
   if (m_fd == -1) {
-    m_fd = ::open(m_device_file.c_str(), O_RDWR);
+    // Non-blocking, so that DQBUF never stalls the capturing thread (or the shared reactor).
+    m_fd = ::open(m_device_file.c_str(), O_RDWR | O_NONBLOCK);
     if (m_fd == -1) {
       auto* err = new vidio_error(vidio_error_code_cannot_open_camera, "Cannot open V4L2 camera device '{0}'");
       err->set_arg(0, m_device_file);
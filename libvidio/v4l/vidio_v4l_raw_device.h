@@ -23,16 +23,23 @@
 
 #include "vidio_video_format_v4l.h"
 #include <libvidio/vidio_error.h>
+#include <atomic>
 #include <mutex>
+#include <memory>
 
 
 struct vidio_v4l_raw_device
 {
 public:
+  vidio_v4l_raw_device();
+
   ~vidio_v4l_raw_device();
 
   vidio_result<bool> query_device(const char* filename);
 
+  // Creates a new (closed) device object with the capabilities and formats of this one, without accessing the device.
+  vidio_v4l_raw_device* copy_device_description() const;
+
   std::string get_bus_info() const { return {(char*) &m_caps.bus_info[0]}; }
 
   std::string get_display_name() const { return {(char*) &m_caps.card[0]}; }
@@ -50,10 +57,70 @@ public:
   const vidio_error* set_capture_format(const vidio_video_format_v4l* requested_format,
                                         const vidio_video_format_v4l** out_actual_format);
 
+  // Runs the capturing loop in the calling thread until stop_capturing() is called.
+  // Errors after capturing has started are passed to capturing_failed(). Only setup errors are returned.
   const vidio_error* start_capturing_blocking(struct vidio_input_device_v4l*);
 
+  // Discards a stop signal that no capturing loop has consumed, e.g. from a stop_capturing() after the loop
+  // ended because of an error, or without a capture. Call before the capturing thread is started.
+  void reset_stop_signal() { drain_wakeup_fd(); }
+
+  // --- The individual steps of the capturing loop, used when the device is served by the vidio_v4l_reactor.
+
+  // Allocates and queues the buffers and switches on streaming.
+  const vidio_error* setup_capturing(struct vidio_input_device_v4l*);
+
+  // Dequeues one filled buffer (if there is one) and pushes it into the input queue.
+  // Returns false if no buffer was ready.
+  vidio_result<bool> capture_next_frame();
+
+  // Releases the buffers after capturing has been stopped.
+  void teardown_capturing();
+
+  // Capturing ended because of an error. Takes ownership of the error and ends the stream of the input.
+  void capturing_failed(const vidio_error* err);
+
+  // Switches to a different format while capturing, without stopping the capturing loop.
+  // The buffers are kept if the new format fits into them and the driver allows it.
+  // On error, capturing is stopped and has to be restarted.
+  const vidio_error* reconfigure_capture(const vidio_video_format_v4l* requested_format,
+                                         const vidio_video_format_v4l** out_actual_format);
+
   const vidio_error* stop_capturing();
 
+  int get_fd() const { return m_fd; }
+
+  // In zero-copy mode, the captured frames directly reference the mmap'ed V4L2 buffers.
+  // A buffer is only given back to the driver when its frame is released.
+  void set_zero_copy(bool enable) { m_zero_copy = enable; }
+
+  // Export the capture buffers as dmabufs and attach them to the frames. Only effective in zero-copy mode
+  // and with driver-allocated (mmap) buffers.
+  void set_export_dmabuf(bool enable) { m_export_dmabuf = enable; }
+
+  // Let the driver capture directly into memory allocated by libvidio (allocator == nullptr) or by the application,
+  // instead of into driver-allocated mmap buffers. Only effective in zero-copy mode.
+  void set_userptr_mode(bool enable, const vidio_v4l_userptr_allocator* allocator)
+  {
+    m_memory = enable ? V4L2_MEMORY_USERPTR : V4L2_MEMORY_MMAP;
+    m_userptr_allocator = allocator ? *allocator : vidio_v4l_userptr_allocator{};
+  }
+
+  // Number of buffers requested from the driver when capturing starts.
+  // When max_count is larger than count, more buffers are added while capturing when the driver drops frames.
+  void set_buffer_count(uint32_t count, uint32_t max_count)
+  {
+    m_buffer_count = count;
+    m_max_buffer_count = max_count;
+  }
+
+  // The number of buffers that are currently allocated. 0 when not capturing.
+  uint32_t get_buffer_count() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex_loop_control);
+    return m_buffers ? (uint32_t) m_buffers->buffers.size() : 0;
+  }
+
   const vidio_error* open();
 
   void close();
@@ -64,7 +131,22 @@ private:
   std::string m_device_file;
   int m_fd = -1; // < 0 if closed
 
-  bool m_capturing_active = false;
+  // V4L2_BUF_TYPE_VIDEO_CAPTURE, or V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE for devices that only support the multi-planar API.
+  __u32 m_buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+  bool is_multiplanar() const { return m_buf_type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE; }
+
+  std::atomic<bool> m_capturing_active{false};
+
+  // eventfd that wakes up the capturing loop of start_capturing_blocking() when capturing is stopped.
+  // Created with the first capture and kept until the device is destroyed.
+  int m_wakeup_fd = -1;
+
+  const vidio_error* create_wakeup_fd();
+
+  void drain_wakeup_fd();
+
+  struct vidio_input_device_v4l* m_input_device = nullptr;
 
   bool m_supports_framerate = false;
   struct v4l2_capability m_caps;
@@ -81,32 +163,170 @@ private:
     std::vector<framesize_v4l> m_framesizes;
   };
 
-  std::vector<format_v4l> m_formats;
+  // The formats are shared by all copies of a device description.
+  // Enumerating the frame sizes and intervals is slow on some cameras (UVC devices can take 100 ms for each
+  // frame interval query). They are therefore only enumerated when the video formats are requested the first time.
+  struct format_list
+  {
+    std::mutex mutex;
+    bool framesizes_queried = false;
+    std::vector<format_v4l> formats;
+  };
+
+  std::shared_ptr<format_list> m_format_list;
+
+  // Fills in the frame sizes and intervals. Has to be called with the format_list mutex held.
+  const vidio_error* query_framesizes() const;
 
   // type = V4L2_BUF_TYPE_VIDEO_CAPTURE or type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE
-  vidio_result<std::vector<v4l2_fmtdesc>> list_v4l_formats(__u32 type) const;
+  static vidio_result<std::vector<v4l2_fmtdesc>> list_v4l_formats(int fd, __u32 type);
 
-  vidio_result<std::vector<v4l2_frmsizeenum>> list_v4l_framesizes(__u32 pixel_type) const;
+  static vidio_result<std::vector<v4l2_frmsizeenum>> list_v4l_framesizes(int fd, __u32 pixel_type);
 
-  vidio_result<std::vector<v4l2_frmivalenum>> list_v4l_frameintervals(__u32 pixel_type, __u32 width, __u32 height) const;
+  static vidio_result<std::vector<v4l2_frmivalenum>> list_v4l_frameintervals(int fd, __u32 pixel_type, __u32 width, __u32 height);
 
 
   const vidio_video_format_v4l* m_capture_format = nullptr;  // this is a copy, it has to be freed
 
-  __u32 m_capture_pixel_format;
-  vidio_pixel_format m_capture_vidio_pixel_format;
-  uint32_t m_capture_width;
-  uint32_t m_capture_height;
+  // The format that the driver is capturing. It can be replaced by reconfigure_capture() while capturing.
+  // capture_next_frame() therefore takes a copy together with each dequeued buffer.
+  struct capture_format
+  {
+    __u32 pixel_format = 0;
+    vidio_pixel_format vidio_format = vidio_pixel_format_undefined;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Memory planes, as reported by the driver. bytesperline may be 0 for compressed formats.
+    uint32_t num_planes = 1;
+    uint32_t bytesperline[VIDEO_MAX_PLANES]{};
+    uint32_t sizeimage[VIDEO_MAX_PLANES]{};
+    vidio_color_matrix color_matrix = vidio_color_matrix_unknown;
+    vidio_color_range color_range = vidio_color_range_unknown;
+
+    int get_stride(int bytes_per_pixel, int plane = 0) const
+    {
+      return bytesperline[plane] ? (int) bytesperline[plane] : (int) width * bytes_per_pixel;
+    }
+  };
+
+  capture_format m_capture;
+
+  // VIDIOC_S_FMT. Returns the ioctl() result, errno is preserved.
+  int try_set_format(const vidio_video_format_v4l* format, capture_format& out_capture) const;
+
+  const vidio_error* set_framerate(const vidio_video_format_v4l* format);
+
+  mutable std::mutex m_mutex_loop_control;
 
-  std::mutex m_mutex_loop_control;
+  bool m_zero_copy = false;
+  bool m_export_dmabuf = false;
 
+  // Incremented on each start of capturing. Zero-copy frames from an earlier capturing session must not re-queue their buffer.
+  uint32_t m_capture_generation = 0;
+
+  struct buffer_plane
+  {
+    void* start = nullptr;
+    size_t length = 0;
+    int dmabuf_fd = -1;  // exported with VIDIOC_EXPBUF, owned by the buffer_set
+  };
+
+  // With the multi-planar API, a buffer can consist of several separately allocated memory planes
+  // (e.g. Y and UV of NV12M). Otherwise, there is only one.
   struct buffer
   {
-    void* start;
-    size_t length;
+    buffer_plane planes[VIDEO_MAX_PLANES];
+    uint32_t num_planes = 0;
+
+    // Dequeued from the driver and not handed back yet, i.e. still in use by a frame (or being copied into one).
+    // Only accessed with m_mutex_loop_control held.
+    bool held = false;
+  };
+
+  struct buffer_set
+  {
+    std::vector<buffer> buffers;
+
+    __u32 memory = V4L2_MEMORY_MMAP;
+    vidio_v4l_userptr_allocator allocator{};  // for V4L2_MEMORY_USERPTR. Uses aligned_alloc() if not set.
+
+    ~buffer_set();
+  };
+
+  // The capture buffers, either mmap'ed driver buffers or user-pointer buffers allocated by us.
+  // Zero-copy frames hold a reference to them such that the memory stays mapped (or allocated)
+  // until the last frame is released, even when capturing has been stopped in between.
+  std::shared_ptr<buffer_set> m_buffers;
+
+  __u32 m_memory = V4L2_MEMORY_MMAP;  // V4L2_MEMORY_MMAP or V4L2_MEMORY_USERPTR
+  vidio_v4l_userptr_allocator m_userptr_allocator{};
+
+  uint32_t m_buffer_count = 4;
+  uint32_t m_max_buffer_count = 0;  // adaptive buffer count is off when not larger than m_buffer_count
+
+  uint32_t m_last_sequence = 0;
+  bool m_sequence_valid = false;
+
+  // For measuring the interruption of the frame stream caused by reconfigure_capture().
+  uint64_t m_last_timestamp_us = 0;
+  uint64_t m_frame_interval_us = 0;
+  bool m_timestamp_valid = false;
+  bool m_reconfigure_pending = false;
+
+  void measure_reconfigure_gap(uint64_t timestamp_us);
+
+  // Requests m_buffer_count buffers from the driver and maps or allocates them.
+  vidio_result<std::shared_ptr<buffer_set>> request_buffers();
+
+  // VIDIOC_REQBUFS with count 0.
+  void release_driver_buffers(__u32 memory);
+
+  bool buffers_fit_format(const buffer_set& buffers, const capture_format& format) const;
+
+  const vidio_error* add_capture_buffer(__u32 index, buffer_set& buffers);
+
+  const vidio_error* map_capture_buffer(__u32 index, buffer_set& buffers);
+
+  const vidio_error* allocate_userptr_buffer(buffer_set& buffers);
+
+  // Hands the buffer (back) to the driver. Returns the ioctl() result.
+  int queue_buffer(const buffer_set& buffers, __u32 index);
+
+  void grow_buffers();
+
+  // Zero-copy frames and their clones can outlive the device. They must never hold a raw pointer to it,
+  // but reach it through this link, which is cut (under its mutex) before the device is destroyed.
+  struct device_link
+  {
+    std::mutex mutex;
+    vidio_v4l_raw_device* device = nullptr;
+  };
+
+  std::shared_ptr<device_link> m_device_link;
+
+  // Owner of the planes of a zero-copy frame. Shared by all clones of the frame.
+  // When the last reference is gone, the buffer is handed back to the driver.
+  struct buffer_reference
+  {
+    std::shared_ptr<device_link> link;
+    std::shared_ptr<buffer_set> buffers;
+    __u32 index;
+    uint32_t generation;
+
+    ~buffer_reference();
   };
 
-  std::vector<buffer> m_buffers;
+  // Hands a dequeued buffer back to the driver, unless capturing was stopped or restarted in between.
+  // Returns the ioctl() result.
+  int requeue_buffer(buffer_set& buffers, __u32 index, uint32_t generation);
+
+  void add_compressed_buffer_plane(struct vidio_frame* frame, vidio_channel_format format,
+                                   const uint8_t* data, size_t size, uint32_t w, uint32_t h,
+                                   const std::shared_ptr<void>& buffer_owner);
+
+  void add_raw_buffer_plane(struct vidio_frame* frame, vidio_color_channel channel,
+                            const uint8_t* data, size_t size, int w, int h, int bpp, int stride,
+                            const std::shared_ptr<void>& buffer_owner);
 };
 
 #endif //LIBVIDIO_VIDIO_V4L_RAW_DEVICE_H
@@ -0,0 +1,237 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "vidio_v4l_reactor.h"
+#include "vidio_v4l_raw_device.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+
+
+vidio_v4l_reactor& vidio_v4l_reactor::get_instance()
+{
+  static vidio_v4l_reactor reactor;
+  return reactor;
+}
+
+
+vidio_v4l_reactor::~vidio_v4l_reactor()
+{
+  stop_threads();
+}
+
+
+void vidio_v4l_reactor::set_num_threads(int n)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_num_threads = std::max(n, 0);
+}
+
+
+int vidio_v4l_reactor::get_num_threads() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_num_threads;
+}
+
+
+const vidio_error* vidio_v4l_reactor::start_threads()
+{
+  if (m_epoll_fd == -1) {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+      auto* err = new vidio_error(vidio_error_code_cannot_start_capturing, "Cannot create epoll instance for V4L2 capturing");
+      err->set_reason(vidio_error::from_errno());
+      return err;
+    }
+
+    int wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_fd == -1) {
+      auto* err = new vidio_error(vidio_error_code_cannot_start_capturing, "Cannot create eventfd for V4L2 capturing");
+      err->set_reason(vidio_error::from_errno());
+      ::close(epoll_fd);
+      return err;
+    }
+
+    // Not one-shot: all threads should see the termination request.
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = cWakeupId;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev);
+
+    m_epoll_fd = epoll_fd;
+    m_wakeup_fd = wakeup_fd;
+  }
+
+  auto num_threads = (size_t) std::max(m_num_threads, 1);
+  while (m_threads.size() < num_threads) {
+    m_threads.emplace_back(&vidio_v4l_reactor::thread_main, this);
+  }
+
+  return nullptr;
+}
+
+
+void vidio_v4l_reactor::stop_threads()
+{
+  // Only called from the destructor. No device can be added anymore.
+
+  if (m_threads.empty()) {
+    return;
+  }
+
+  uint64_t one = 1;
+  ssize_t n = ::write(m_wakeup_fd, &one, sizeof(one));
+  (void) n;
+
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+  m_threads.clear();
+
+  ::close(m_wakeup_fd);
+  ::close(m_epoll_fd);
+  m_wakeup_fd = -1;
+  m_epoll_fd = -1;
+}
+
+
+const vidio_error* vidio_v4l_reactor::add_device(vidio_v4l_raw_device* device)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  const vidio_error* err = start_threads();
+  if (err) {
+    return err;
+  }
+
+  uint64_t id = m_next_id++;
+  m_registrations[id] = registration{device};
+
+  epoll_event ev{};
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.u64 = id;
+
+  if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, device->get_fd(), &ev) == -1) {
+    m_registrations.erase(id);
+
+    auto* add_err = new vidio_error(vidio_error_code_cannot_start_capturing, "Cannot add V4L2 device to epoll set");
+    add_err->set_reason(vidio_error::from_errno());
+    return add_err;
+  }
+
+  return nullptr;
+}
+
+
+void vidio_v4l_reactor::remove_device(vidio_v4l_raw_device* device)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (auto iter = m_registrations.begin(); iter != m_registrations.end(); ++iter) {
+    if (iter->second.device == device) {
+      epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, device->get_fd(), nullptr);
+
+      uint64_t id = iter->first;
+      m_handler_finished.wait(lock, [this, id]() { return !m_registrations[id].in_flight; });
+
+      m_registrations.erase(id);
+      break;
+    }
+  }
+
+  // The threads are kept even when no device is left. Stopping them here would race with a concurrent
+  // add_device(), and the next capture would have to start them again.
+}
+
+
+void vidio_v4l_reactor::thread_main()
+{
+  const int cMaxEvents = 16;
+  epoll_event events[cMaxEvents];
+
+  for (;;) {
+    int n = epoll_wait(m_epoll_fd, events, cMaxEvents, -1);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return;
+    }
+
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.u64 == cWakeupId) {
+        return;
+      }
+
+      handle_device(events[i].data.u64);
+    }
+  }
+}
+
+
+void vidio_v4l_reactor::handle_device(uint64_t id)
+{
+  vidio_v4l_raw_device* device;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto iter = m_registrations.find(id);
+    if (iter == m_registrations.end()) {
+      return;
+    }
+
+    device = iter->second.device;
+    iter->second.in_flight = true;
+  }
+
+  // Drain all filled buffers. The device is non-blocking, so this returns false as soon as no buffer is ready.
+  bool rearm = true;
+  for (;;) {
+    auto result = device->capture_next_frame();
+    if (result.error) {
+      // The capture will not recover from this. Leave the device disarmed until it is removed,
+      // and let the input signal the end of the stream.
+      device->capturing_failed(result.error);
+      rearm = false;
+      break;
+    }
+
+    if (!result.value) {
+      break;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (rearm) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.u64 = id;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, device->get_fd(), &ev);
+  }
+
+  m_registrations[id].in_flight = false;
+  m_handler_finished.notify_all();
+}
@@ -0,0 +1,94 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVIDIO_VIDIO_V4L_REACTOR_H
+#define LIBVIDIO_VIDIO_V4L_REACTOR_H
+
+#include <libvidio/vidio_error.h>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+struct vidio_v4l_raw_device;
+
+
+// Serves all capturing V4L2 devices from a single epoll set with a small number of threads,
+// instead of running one capturing thread per device.
+// Devices are registered with EPOLLONESHOT, so that a device is only handled by one thread at a time.
+class vidio_v4l_reactor
+{
+public:
+  static vidio_v4l_reactor& get_instance();
+
+  // 0 means that each device runs its own capturing thread (the reactor is not used).
+  // Missing threads are started when the next device is added. The threads are only stopped when the library
+  // is unloaded, so a smaller number of threads does not reduce the running threads.
+  void set_num_threads(int n);
+
+  int get_num_threads() const;
+
+  // The device must have been set up with vidio_v4l_raw_device::setup_capturing().
+  const vidio_error* add_device(vidio_v4l_raw_device* device);
+
+  // Returns when the device is not handled by any reactor thread anymore.
+  void remove_device(vidio_v4l_raw_device* device);
+
+private:
+  vidio_v4l_reactor() = default;
+
+  ~vidio_v4l_reactor();
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_handler_finished;
+
+  int m_num_threads = 0;
+
+  int m_epoll_fd = -1;
+  int m_wakeup_fd = -1;  // eventfd, signalled to terminate the threads
+  std::vector<std::thread> m_threads;
+
+  struct registration
+  {
+    vidio_v4l_raw_device* device;
+    bool in_flight = false;
+  };
+
+  // The epoll events carry the registration id instead of a pointer. An event for a device that has been
+  // removed in the meantime then simply does not find its registration anymore.
+  std::map<uint64_t, registration> m_registrations;
+  uint64_t m_next_id = 1;
+
+  static const uint64_t cWakeupId = 0;
+
+  // Creates the epoll set on first use and starts threads until there are get_num_threads() (at least one).
+  const vidio_error* start_threads();
+
+  void stop_threads();
+
+  void thread_main();
+
+  void handle_device(uint64_t id);
+};
+
+#endif //LIBVIDIO_VIDIO_V4L_REACTOR_H
@@ -35,8 +35,17 @@ static vidio_pixel_format_class v4l_pixelformat_to_pixel_format_class(__u32 pixe
     case V4L2_PIX_FMT_HEVC:
       return vidio_pixel_format_class_H265;
     case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12M:
+    case V4L2_PIX_FMT_NV16:
+    case V4L2_PIX_FMT_NV16M:
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_NV21M:
+    case V4L2_PIX_FMT_UYVY:
+    case V4L2_PIX_FMT_GREY:
       return vidio_pixel_format_class_YUV;
     case V4L2_PIX_FMT_SRGGB8:
+    case V4L2_PIX_FMT_BGR24:
       return vidio_pixel_format_class_RGB;
     default:
       return vidio_pixel_format_class_unknown;
@@ -58,6 +67,21 @@ static vidio_pixel_format v4l_pixelformat_to_pixel_format(__u32 pixelformat)
       return vidio_pixel_format_H265;
     case V4L2_PIX_FMT_YUYV:
       return vidio_pixel_format_YUV422_YUYV;
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12M:
+      return vidio_pixel_format_YUV420_NV12;
+    case V4L2_PIX_FMT_NV16:
+    case V4L2_PIX_FMT_NV16M:
+      return vidio_pixel_format_YUV422_NV16;
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_NV21M:
+      return vidio_pixel_format_YUV420_NV21;
+    case V4L2_PIX_FMT_UYVY:
+      return vidio_pixel_format_YUV422_UYVY;
+    case V4L2_PIX_FMT_GREY:
+      return vidio_pixel_format_GREY8;
+    case V4L2_PIX_FMT_BGR24:
+      return vidio_pixel_format_BGR8;
     case V4L2_PIX_FMT_SRGGB8:
       return vidio_pixel_format_RGB8;
     default:
@@ -84,7 +108,7 @@ vidio_video_format_v4l::vidio_video_format_v4l(const nlohmann::json& json)
 {
   // v4l2_fmtdesc
 
-  m_format.type = json["format_type"]; // V4L2_BUF_TYPE_VIDEO_CAPTURE or V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE (TODO: in the future)
+  m_format.type = json["format_type"]; // V4L2_BUF_TYPE_VIDEO_CAPTURE or V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE
   m_format.flags = json["format_flags"];
   m_format.pixelformat = json["format_pixelformat"];
   m_format.mbus_code = json["format_mbus_code"];
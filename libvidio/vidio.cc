@@ -27,6 +27,8 @@
 #include "libvidio/colorconversion/converter.h"
 #if WITH_VIDEO4LINUX2
 #include "libvidio/v4l/vidio_input_device_v4l.h"
+#include "libvidio/v4l/vidio_v4l_reactor.h"
+#include "libvidio/v4l/vidio_v4l_device_registry.h"
 #endif
 #if WITH_RTSP
 #include "libvidio/rtsp/vidio_input_device_rtsp.h"
@@ -191,6 +193,17 @@ void vidio_input_device_free(const struct vidio_input_device* device)
 }
 
 
+void vidio_set_device_change_callback(vidio_device_change_callback callback, void* user_data)
+{
+#if WITH_VIDEO4LINUX2
+  vidio_v4l_device_registry::get_instance().set_device_change_callback(callback, user_data);
+#else
+  (void)callback;
+  (void)user_data;
+#endif
+}
+
+
 const char* vidio_input_serialize(const struct vidio_input* input, vidio_serialization_format serialformat)
 {
   return make_vidio_string(input->serialize(serialformat));
@@ -299,6 +312,51 @@ int64_t vidio_frame_get_dts_us(const vidio_frame* f)
   return f->get_dts_us();
 }
 
+vidio_bool vidio_frame_has_sequence_number(const vidio_frame* f)
+{
+  return f->has_sequence_number();
+}
+
+uint32_t vidio_frame_get_sequence_number(const vidio_frame* f)
+{
+  return f->get_sequence_number();
+}
+
+enum vidio_clock_domain vidio_frame_get_clock_domain(const vidio_frame* f)
+{
+  return f->get_clock_domain();
+}
+
+enum vidio_timestamp_source vidio_frame_get_timestamp_source(const vidio_frame* f)
+{
+  return f->get_timestamp_source();
+}
+
+enum vidio_color_matrix vidio_frame_get_color_matrix(const vidio_frame* f)
+{
+  return f->get_color_matrix();
+}
+
+enum vidio_color_range vidio_frame_get_color_range(const vidio_frame* f)
+{
+  return f->get_color_range();
+}
+
+void vidio_frame_set_colorimetry(vidio_frame* f, enum vidio_color_matrix matrix, enum vidio_color_range range)
+{
+  f->set_colorimetry(matrix, range);
+}
+
+uint64_t vidio_frame_get_dequeue_timestamp_us(const vidio_frame* f)
+{
+  return f->get_dequeue_timestamp_us();
+}
+
+void vidio_set_monotonic_timestamps(vidio_bool enable)
+{
+  vidio_input::set_monotonic_timestamps(enable);
+}
+
 void vidio_frame_set_codec_extradata(vidio_frame* f, const uint8_t* data, int size)
 {
   f->set_codec_extradata(data, size);
@@ -322,6 +380,30 @@ vidio_frame* vidio_frame_clone(const vidio_frame* f)
   return f->clone();
 }
 
+vidio_bool vidio_frame_get_dmabuf(const vidio_frame* f, int* out_fd, size_t* out_offset, size_t* out_size)
+{
+  if (!f->has_dmabuf()) {
+    return false;
+  }
+
+  if (out_fd) {
+    *out_fd = f->get_dmabuf_fd();
+  }
+  if (out_offset) {
+    *out_offset = f->get_dmabuf_offset();
+  }
+  if (out_size) {
+    *out_size = f->get_dmabuf_size();
+  }
+
+  return true;
+}
+
+vidio_frame* vidio_frame_copy(const vidio_frame* f)
+{
+  return f->deep_copy();
+}
+
 
 const struct vidio_video_format* const*
 vidio_input_get_video_formats(const struct vidio_input* input, size_t* out_number)
@@ -486,11 +568,31 @@ const vidio_error* vidio_input_stop_capturing(struct vidio_input* input)
 }
 
 
+const vidio_error* vidio_input_reconfigure_capture(struct vidio_input* input,
+                                                   const vidio_video_format* requested_format,
+                                                   const vidio_video_format** out_actual_format)
+{
+  return input->reconfigure_capture(requested_format, out_actual_format);
+}
+
+
+vidio_bool vidio_input_get_reconfigure_gap(const struct vidio_input* input,
+                                           int64_t* out_gap_us, int* out_missed_frames)
+{
+  return input->get_reconfigure_gap(out_gap_us, out_missed_frames);
+}
+
+
 vidio_frame* vidio_frame_convert(const vidio_frame* f, vidio_pixel_format format)
 {
   return convert_frame(f, format);
 }
 
+void vidio_frame_convert_release_resources()
+{
+  release_convert_frame_resources();
+}
+
 
 vidio_format_converter* vidio_create_format_converter(vidio_pixel_format from, vidio_pixel_format to)
 {
@@ -502,6 +604,11 @@ void vidio_format_converter_free(vidio_format_converter* converter)
   delete converter;
 }
 
+void vidio_format_converter_set_num_threads(vidio_format_converter* converter, int num_threads)
+{
+  converter->set_num_threads(num_threads);
+}
+
 vidio_frame* vidio_format_converter_convert_uncompressed(vidio_format_converter* converter, const vidio_frame* f)
 {
   converter->push(f);
@@ -529,11 +636,186 @@ void vidio_input_pop_next_frame(struct vidio_input* input)
 }
 
 
+vidio_bool vidio_input_wait_for_frame(struct vidio_input* input, int64_t timeout_us)
+{
+  return input->wait_for_frame(timeout_us);
+}
+
+
+vidio_bool vidio_input_is_end_of_stream(const struct vidio_input* input)
+{
+  return input->is_end_of_stream();
+}
+
+int vidio_input_get_event_fd(struct vidio_input* input)
+{
+  return input->get_event_fd();
+}
+
 void vidio_input_release(struct vidio_input* input)
 {
   delete input;
 }
 
+const struct vidio_error* vidio_input_set_queue_depth(struct vidio_input* input, int max_frames, size_t max_bytes)
+{
+  return input->set_queue_depth(max_frames, max_bytes);
+}
+
+void vidio_input_set_overflow_policy(struct vidio_input* input, enum vidio_overflow_policy policy)
+{
+  input->set_overflow_policy(policy);
+}
+
+void vidio_input_set_delivery_mode(struct vidio_input* input, enum vidio_delivery_mode mode)
+{
+  input->set_delivery_mode(mode);
+}
+
+uint64_t vidio_input_get_superseded_frame_count(const struct vidio_input* input)
+{
+  return input->get_superseded_frame_count();
+}
+
+void vidio_input_get_frame_pool_statistics(const struct vidio_input* input,
+                                           struct vidio_frame_pool_statistics* out_stats)
+{
+  input->get_frame_pool().get_statistics(out_stats);
+}
+
+void vidio_input_set_frame_pool_high_water_mark(struct vidio_input* input, size_t max_frames)
+{
+  input->get_frame_pool().set_high_water_mark(max_frames);
+}
+
+void vidio_input_get_drop_statistics(const struct vidio_input* input,
+                                     struct vidio_input_drop_statistics* out_stats)
+{
+  input->get_drop_statistics(out_stats);
+}
+
+
+// === V4L2 Input ===
+
+void vidio_v4l_set_zero_copy(vidio_input* input, vidio_bool enable)
+{
+#if WITH_VIDEO4LINUX2
+  if (!input) {
+    return;
+  }
+  auto* v4l_input = dynamic_cast<vidio_input_device_v4l*>(input);
+  if (v4l_input) {
+    v4l_input->set_zero_copy(enable != 0);
+  }
+#else
+  (void)input;
+  (void)enable;
+#endif
+}
+
+
+void vidio_v4l_set_export_dmabuf(vidio_input* input, vidio_bool enable)
+{
+#if WITH_VIDEO4LINUX2
+  if (!input) {
+    return;
+  }
+  auto* v4l_input = dynamic_cast<vidio_input_device_v4l*>(input);
+  if (v4l_input) {
+    v4l_input->set_export_dmabuf(enable != 0);
+  }
+#else
+  (void)input;
+  (void)enable;
+#endif
+}
+
+
+void vidio_v4l_set_userptr_mode(vidio_input* input, vidio_bool enable, const vidio_v4l_userptr_allocator* allocator)
+{
+#if WITH_VIDEO4LINUX2
+  if (!input) {
+    return;
+  }
+  auto* v4l_input = dynamic_cast<vidio_input_device_v4l*>(input);
+  if (v4l_input) {
+    v4l_input->set_userptr_mode(enable != 0, allocator);
+  }
+#else
+  (void)input;
+  (void)enable;
+  (void)allocator;
+#endif
+}
+
+
+const struct vidio_error* vidio_v4l_set_buffer_count(struct vidio_input* input, uint32_t count, uint32_t max_count)
+{
+#if WITH_VIDEO4LINUX2
+  auto* v4l_input = dynamic_cast<vidio_input_device_v4l*>(input);
+  if (!v4l_input) {
+    return new vidio_error(vidio_error_code_usage_error, "Usage error: buffer count can only be set for V4L2 inputs");
+  }
+
+  if (count < 2) {
+    auto* err = new vidio_error(vidio_error_code_parameter_error, "Parameter error: at least 2 capture buffers are required (count={0})");
+    err->set_arg(0, std::to_string(count));
+    return err;
+  }
+
+  v4l_input->set_buffer_count(count, max_count);
+  return nullptr;
+#else
+  (void)input;
+  (void)count;
+  (void)max_count;
+  return new vidio_error(vidio_error_code_usage_error, "Usage error: buffer count can only be set for V4L2 inputs");
+#endif
+}
+
+
+uint32_t vidio_v4l_get_buffer_count(const struct vidio_input* input)
+{
+#if WITH_VIDEO4LINUX2
+  auto* v4l_input = dynamic_cast<const vidio_input_device_v4l*>(input);
+  if (v4l_input) {
+    return v4l_input->get_buffer_count();
+  }
+#else
+  (void)input;
+#endif
+  return 0;
+}
+
+
+const struct vidio_error* vidio_v4l_create_additional_stream(const struct vidio_input* input,
+                                                            struct vidio_input** out_stream)
+{
+#if WITH_VIDEO4LINUX2
+  auto* v4l_input = dynamic_cast<const vidio_input_device_v4l*>(input);
+  if (!v4l_input) {
+    return new vidio_error(vidio_error_code_usage_error, "Usage error: additional streams can only be created for V4L2 inputs");
+  }
+
+  *out_stream = v4l_input->create_additional_stream();
+  return nullptr;
+#else
+  (void)input;
+  (void)out_stream;
+  return new vidio_error(vidio_error_code_usage_error, "Usage error: additional streams can only be created for V4L2 inputs");
+#endif
+}
+
+
+void vidio_v4l_set_reactor_threads(int num_threads)
+{
+#if WITH_VIDEO4LINUX2
+  vidio_v4l_reactor::get_instance().set_num_threads(num_threads);
+#else
+  (void)num_threads;
+#endif
+}
+
 
 // === RTSP Input ===
 
@@ -148,10 +148,20 @@ enum vidio_pixel_format
   // RGB
   vidio_pixel_format_RGB8 = 1,
   vidio_pixel_format_RGB8_planar = 2,
+  vidio_pixel_format_BGR8 = 3,
+  vidio_pixel_format_RGBA8 = 4,  // interleaved, 32 bits per pixel. Alpha is 255 when converted from formats without alpha.
+  vidio_pixel_format_BGRA8 = 5,
 
   // YUV
   vidio_pixel_format_YUV420_planar = 100,
   vidio_pixel_format_YUV422_YUYV = 101,
+  vidio_pixel_format_YUV420_NV12 = 102,  // Y plane + interleaved UV plane (vidio_color_channel_UV)
+  vidio_pixel_format_YUV422_NV16 = 103,  // Y plane + interleaved UV plane (vidio_color_channel_UV)
+  vidio_pixel_format_YUV420_NV21 = 104,  // like NV12, but with V before U in the vidio_color_channel_UV plane
+  vidio_pixel_format_YUV422_UYVY = 105,
+
+  // Greyscale (single vidio_color_channel_Y plane)
+  vidio_pixel_format_GREY8 = 300,
 
   // Bayer
   vidio_pixel_format_RGGB8 = 200,
@@ -184,6 +194,7 @@ enum vidio_color_channel
   vidio_color_channel_V = 6,
   vidio_color_channel_alpha = 7,
   vidio_color_channel_depth = 8,
+  vidio_color_channel_UV = 9,  // interleaved U and V samples (V and U for NV21), 16 bits per chroma sample pair
   vidio_color_channel_interleaved = 100,
   vidio_color_channel_compressed = 101
 };
@@ -218,6 +229,7 @@ LIBVIDIO_API enum vidio_pixel_format vidio_frame_get_pixel_format(const struct v
 
 LIBVIDIO_API vidio_bool vidio_frame_has_color_plane(const struct vidio_frame*, enum vidio_color_channel);
 
+// Writable access to the plane. If the plane memory is shared with a cloned frame, it is copied first.
 LIBVIDIO_API uint8_t* vidio_frame_get_color_plane(vidio_frame*, enum vidio_color_channel, int* stride);
 
 LIBVIDIO_API const uint8_t* vidio_frame_get_color_plane_readonly(const struct vidio_frame*, enum vidio_color_channel, int* stride);
@@ -233,29 +245,144 @@ LIBVIDIO_API void vidio_frame_set_dts_us(struct vidio_frame*, int64_t dts_us);
 LIBVIDIO_API vidio_bool vidio_frame_has_dts(const struct vidio_frame*);
 LIBVIDIO_API int64_t vidio_frame_get_dts_us(const struct vidio_frame*);
 
+// The clock that a frame timestamp refers to.
+enum vidio_clock_domain
+{
+  vidio_clock_domain_unknown = 0,
+  vidio_clock_domain_monotonic = 1,  // CLOCK_MONOTONIC (std::chrono::steady_clock)
+  vidio_clock_domain_realtime = 2,   // wall clock time (CLOCK_REALTIME), used by old V4L2 drivers
+  vidio_clock_domain_stream = 3      // presentation timestamps of a media stream (RTSP, files), unrelated to any system clock
+};
+
+// The moment in the capture process at which the driver took the timestamp.
+enum vidio_timestamp_source
+{
+  vidio_timestamp_source_unknown = 0,
+  vidio_timestamp_source_end_of_frame = 1,       // after the last pixel has been received
+  vidio_timestamp_source_start_of_exposure = 2   // when the sensor started the exposure of the frame
+};
+
+// Frame counter of the V4L2 driver. Gaps in the sequence mean that the driver dropped frames.
+// Frames of other inputs have no sequence number.
+LIBVIDIO_API vidio_bool vidio_frame_has_sequence_number(const struct vidio_frame*);
+LIBVIDIO_API uint32_t vidio_frame_get_sequence_number(const struct vidio_frame*);
+
+LIBVIDIO_API enum vidio_clock_domain vidio_frame_get_clock_domain(const struct vidio_frame*);
+
+LIBVIDIO_API enum vidio_timestamp_source vidio_frame_get_timestamp_source(const struct vidio_frame*);
+
+/**
+ * Get the CLOCK_MONOTONIC time at which libvidio received the frame from the driver, network stream or file.
+ * When the frame timestamp is also in the monotonic clock domain, the difference of both is the capture latency
+ * of the driver. The time between this timestamp and the moment the application processes the frame is the
+ * latency of the frame queue.
+ *
+ * @return The time in microseconds, or 0 if it is not known.
+ */
+LIBVIDIO_API uint64_t vidio_frame_get_dequeue_timestamp_us(const struct vidio_frame*);
+
+// Matrix of the YUV (YCbCr) encoding.
+enum vidio_color_matrix
+{
+  vidio_color_matrix_unknown = 0,  // treated as BT.601 when converting to RGB
+  vidio_color_matrix_bt601 = 1,    // SD video, JPEG
+  vidio_color_matrix_bt709 = 2,    // HD video
+  vidio_color_matrix_bt2020 = 3    // UHD video (non-constant luminance)
+};
+
+enum vidio_color_range
+{
+  vidio_color_range_unknown = 0,   // treated as limited range when converting to RGB
+  vidio_color_range_limited = 1,   // Y: 16-235, UV: 16-240
+  vidio_color_range_full = 2       // 0-255
+};
+
+/**
+ * Get the colorimetry of the frame. It is taken from the V4L2 format (colorspace, ycbcr_enc, quantization)
+ * or from the FFmpeg decoder. The conversion to RGB uses the matching coefficients.
+ * The values only apply to YUV pixel formats.
+ */
+LIBVIDIO_API enum vidio_color_matrix vidio_frame_get_color_matrix(const struct vidio_frame*);
+LIBVIDIO_API enum vidio_color_range vidio_frame_get_color_range(const struct vidio_frame*);
+
+/**
+ * Override the colorimetry of the frame, e.g. for cameras that report wrong values.
+ */
+LIBVIDIO_API void vidio_frame_set_colorimetry(struct vidio_frame*, enum vidio_color_matrix, enum vidio_color_range);
+
+/**
+ * Convert the timestamps of all captured frames to CLOCK_MONOTONIC, such that frames of different inputs can be
+ * compared. This is a library-wide setting that applies to frames captured after the call.
+ *
+ * Wall clock timestamps are shifted by the current offset between both clocks. Stream timestamps (RTSP, files)
+ * are anchored at the dequeue time of the first frame of each capture and advance with the stream timestamps
+ * from there. Decode timestamps are shifted by the same amount.
+ *
+ * @param enable Whether to convert the timestamps (default: off).
+ */
+LIBVIDIO_API void vidio_set_monotonic_timestamps(vidio_bool enable);
+
 // Codec extradata (SPS/PPS for H264, SPS/PPS/VPS for H265)
 LIBVIDIO_API void vidio_frame_set_codec_extradata(struct vidio_frame*, const uint8_t* data, int size);
 LIBVIDIO_API vidio_bool vidio_frame_has_codec_extradata(const struct vidio_frame*);
 LIBVIDIO_API const uint8_t* vidio_frame_get_codec_extradata(const struct vidio_frame*, int* out_size);
 
-// Deep copy of a frame (all planes and metadata)
+/**
+ * Get the dmabuf (Linux DMA buffer) that holds the frame data, if there is one.
+ * This is available for V4L2 inputs with vidio_v4l_set_export_dmabuf() enabled.
+ * The fd remains owned by the frame and is valid until the frame (and all its clones) are freed.
+ * Use dup() to keep it for longer. When the frame data is modified, the frame does not have a dmabuf anymore.
+ *
+ * @param out_fd The dmabuf file descriptor.
+ * @param out_offset Offset of the frame data in the dmabuf. May be NULL.
+ * @param out_size Size of the frame data in bytes. May be NULL.
+ * @return Whether the frame has a dmabuf. If not, the output parameters are not changed.
+ */
+LIBVIDIO_API vidio_bool vidio_frame_get_dmabuf(const struct vidio_frame*, int* out_fd, size_t* out_offset, size_t* out_size);
+
+// Copy of a frame that shares the plane memory with the original frame (copy-on-write).
+// This is cheap and can be used to pass the same frame to several consumers.
 LIBVIDIO_API struct vidio_frame* vidio_frame_clone(const struct vidio_frame*);
 
+// Deep copy of a frame (all planes and metadata)
+LIBVIDIO_API struct vidio_frame* vidio_frame_copy(const struct vidio_frame*);
+
 
 // === Format Conversion ===
 
 // TODO: should return vidio_error. Should we remove this completely in favor of vidio_format_converter, or keep it as
 //       a convenience wrapper around video_format_converter.
+// Returns NULL if the conversion is not supported.
+// H264 and H265 frames cannot be converted with this function (NULL is returned), because decoding them depends on the
+// previous frames of the same stream. Use one vidio_create_format_converter() per stream for them.
 LIBVIDIO_API struct vidio_frame* vidio_frame_convert(const struct vidio_frame*, enum vidio_pixel_format);
 
+/**
+ * vidio_frame_convert() keeps the converters (and the MJPEG decoder) of each thread open for the next frame.
+ * This frees those of the calling thread. They are also freed automatically when the thread ends.
+ */
+LIBVIDIO_API void vidio_frame_convert_release_resources(void);
+
 
 struct vidio_format_converter;
 
+// All raw pixel formats can be converted into each other (Bayer only as input). Compressed formats (MJPEG, H264, H265)
+// can be decoded into any raw format except Bayer. Returns NULL if the conversion is not supported.
 // TODO: should return vidio_error if format conversion is not supported. Add conversion options?
 LIBVIDIO_API struct vidio_format_converter* vidio_create_format_converter(enum vidio_pixel_format from, enum vidio_pixel_format to);
 
 LIBVIDIO_API void vidio_format_converter_free(struct vidio_format_converter*);
 
+/**
+ * Split the conversion of each frame into horizontal slices that are converted in parallel by worker threads
+ * of the library. This does not apply to decoding compressed frames, only to the conversion of the pixel format.
+ *
+ * @param num_threads Maximum number of threads, including the calling thread. 1 (default) converts on the
+ *                    calling thread only, 0 uses one thread per CPU core. Larger values are limited to
+ *                    the number of CPU cores.
+ */
+LIBVIDIO_API void vidio_format_converter_set_num_threads(struct vidio_format_converter*, int num_threads);
+
 // TODO: should return vidio_error
 LIBVIDIO_API void vidio_format_converter_push_compressed(struct vidio_format_converter*, const struct vidio_frame*);
 
@@ -318,6 +445,8 @@ LIBVIDIO_API const struct vidio_video_format* vidio_video_format_find_best_match
  * Get a list of video formats supported by this input.
  * The returned list and its entries must be released with `vidio_video_formats_free_list`.
  * The returned number of entries does not include the NULL termination.
+ * For V4L2 devices, the frame sizes and frame rates are queried from the device on the first call,
+ * which may take some time for cameras with many formats.
  *
  * @param input The video input.
  * @param out_number The number of video formats returned. Optional, may be NULL.
@@ -367,6 +496,21 @@ enum vidio_rtsp_transport
   vidio_rtsp_transport_udp = 2
 };
 
+// What happens when a new frame is captured, but the input queue is full.
+enum vidio_overflow_policy
+{
+  vidio_overflow_policy_drop_newest = 0,  // discard the new frame (default)
+  vidio_overflow_policy_drop_oldest = 1,  // discard the oldest queued frames to make room for the new frame
+  vidio_overflow_policy_block = 2         // wait until the application has popped a frame (e.g. for offline file processing)
+};
+
+// How captured frames are handed to the application.
+enum vidio_delivery_mode
+{
+  vidio_delivery_mode_queue = 0,        // all frames are queued and delivered in capture order (default)
+  vidio_delivery_mode_latest_frame = 1  // only the newest frame is kept ("mailbox"). A frame that has not been peeked yet is replaced by the next one.
+};
+
 enum vidio_input_message
 {
   vidio_input_message_new_frame,
@@ -381,6 +525,30 @@ LIBVIDIO_API void vidio_input_devices_free_list(const struct vidio_input_device*
 
 LIBVIDIO_API void vidio_input_device_free(const struct vidio_input_device* device);
 
+enum vidio_device_change
+{
+  vidio_device_change_added = 0,
+  vidio_device_change_removed = 1
+};
+
+typedef void (*vidio_device_change_callback)(enum vidio_device_change change,
+                                             const char* device_file, const char* display_name,
+                                             void* user_data);
+
+/**
+ * Get notified when a capture device is plugged in or removed.
+ * The device list is kept up to date in the background (currently for V4L2 devices), such that
+ * vidio_list_input_devices() does not have to query all devices each time. Call vidio_list_input_devices()
+ * from the callback or later to get the new device list.
+ *
+ * The callback is called from a background thread. The strings are only valid during the callback.
+ * Note that one camera may consist of several device files.
+ *
+ * @param callback The callback function, or NULL to remove the callback.
+ * @param user_data Passed to the callback.
+ */
+LIBVIDIO_API void vidio_set_device_change_callback(vidio_device_change_callback callback, void* user_data);
+
 // If JSON has not been compiled in, NULL is returned.
 LIBVIDIO_API const char* vidio_input_serialize(const struct vidio_input* input, enum vidio_serialization_format);
 
@@ -419,13 +587,273 @@ LIBVIDIO_API const struct vidio_error* vidio_input_start_capturing(struct vidio_
 
 LIBVIDIO_API const struct vidio_error* vidio_input_stop_capturing(struct vidio_input* input);
 
+/**
+ * Switch to a different capture format while capturing, e.g. from a low-resolution preview to a full-resolution
+ * capture. V4L2 inputs keep their capturing thread running and keep the capture buffers if the new format fits
+ * into them, which is much faster than stopping and restarting capturing. Other inputs are restarted.
+ * Frames in the old format that are still queued are delivered first.
+ * If capturing has not been started yet, this is the same as vidio_input_configure_capture().
+ *
+ * @param input The video input.
+ * @param requested_format The new format, as obtained from vidio_input_get_video_formats().
+ * @param out_actual_format Optional. Receives the format that is captured now. Release it with vidio_video_format_free().
+ *                          May be set to NULL if the input does not report it.
+ */
+LIBVIDIO_API const struct vidio_error* vidio_input_reconfigure_capture(struct vidio_input* input,
+                                                                       const struct vidio_video_format* requested_format,
+                                                                       const struct vidio_video_format** out_actual_format);
+
+/**
+ * Get the interruption of the frame stream caused by the last vidio_input_reconfigure_capture().
+ * It is measured between the capture timestamps of the last frame before and the first frame after the switch,
+ * so it is only available once a frame in the new format has been captured.
+ *
+ * @param input The video input.
+ * @param out_gap_us Optional. Time between the two frames in microseconds.
+ * @param out_missed_frames Optional. Number of frame periods (of the new format) without a frame, or -1 if unknown.
+ * @return Whether the gap has been measured.
+ */
+LIBVIDIO_API vidio_bool vidio_input_get_reconfigure_gap(const struct vidio_input* input,
+                                                        int64_t* out_gap_us, int* out_missed_frames);
+
 // Do not free the returned frame. It will be released or reused in vidio_input_pop_next_frame().
 LIBVIDIO_API const struct vidio_frame* vidio_input_peek_next_frame(struct vidio_input* input);
 
 LIBVIDIO_API void vidio_input_pop_next_frame(struct vidio_input* input);
 
+/**
+ * Wait until a frame can be taken with vidio_input_peek_next_frame().
+ * The function also returns when the end of stream is reached or capturing is stopped.
+ * After that, it does not block anymore until capturing is started again.
+ *
+ * @param input The input.
+ * @param timeout_us Maximum waiting time in microseconds. A negative value waits without time limit.
+ * @return Whether a frame is available.
+ */
+LIBVIDIO_API vidio_bool vidio_input_wait_for_frame(struct vidio_input* input, int64_t timeout_us);
+
+/**
+ * Check whether the stream has ended (end of file, connection lost, or capturing stopped)
+ * and all remaining frames have been taken from the input.
+ * This is reset when capturing is started again.
+ */
+LIBVIDIO_API vidio_bool vidio_input_is_end_of_stream(const struct vidio_input* input);
+
+/**
+ * Get a file descriptor that is readable while frames are queued in the input, or when the stream has ended.
+ * It can be added to a poll/epoll loop to wait for frames of many inputs in a single thread.
+ * The descriptor stays readable until all queued frames have been popped. After the end of the stream, it stays
+ * readable until capturing is started again. Check vidio_input_is_end_of_stream() to remove the input from the loop.
+ * Do not read from it or close it.
+ * It is valid until the input is released.
+ *
+ * @param input The input.
+ * @return The file descriptor (an eventfd), or -1 if this is not supported on the platform.
+ */
+LIBVIDIO_API int vidio_input_get_event_fd(struct vidio_input* input);
+
 LIBVIDIO_API void vidio_input_release(struct vidio_input* input);
 
+/**
+ * Set the size of the queue of captured frames that have not been popped yet.
+ * Must be called before starting capture.
+ *
+ * @param input The input.
+ * @param max_frames Maximum number of queued frames (default: 20).
+ * @param max_bytes Maximum plane memory of all queued frames, or 0 for no limit (default: 0).
+ *                  A single frame is always accepted, even if it is larger than this budget.
+ */
+LIBVIDIO_API const struct vidio_error* vidio_input_set_queue_depth(struct vidio_input* input,
+                                                                   int max_frames, size_t max_bytes);
+
+/**
+ * Set what happens when a frame is captured while the queue is full.
+ * A 'vidio_input_message_input_overflow' message is sent whenever a frame is dropped.
+ * With 'vidio_overflow_policy_block', the input stops reading until a frame is popped. Stopping the capture
+ * will not block. V4L2 inputs served by shared threads (see vidio_v4l_set_reactor_threads()) cannot block,
+ * as this would stall the other inputs. They drop the new frame instead, like 'vidio_overflow_policy_drop_newest'.
+ * Must be called before starting capture.
+ *
+ * @param input The input.
+ * @param policy The overflow policy (default: vidio_overflow_policy_drop_newest).
+ */
+LIBVIDIO_API void vidio_input_set_overflow_policy(struct vidio_input* input, enum vidio_overflow_policy policy);
+
+/**
+ * Select whether the application receives all frames in order, or always the newest frame only.
+ * The latest-frame mode is meant for live previews and control loops where latency is more important
+ * than seeing every frame. The queue depth and overflow policy are not used in this mode.
+ * Must be called before starting capture.
+ *
+ * @param input The input.
+ * @param mode The delivery mode (default: vidio_delivery_mode_queue).
+ */
+LIBVIDIO_API void vidio_input_set_delivery_mode(struct vidio_input* input, enum vidio_delivery_mode mode);
+
+// Number of frames that were replaced by a newer frame before they were peeked (latest-frame delivery mode only).
+LIBVIDIO_API uint64_t vidio_input_get_superseded_frame_count(const struct vidio_input* input);
+
+struct vidio_frame_pool_statistics
+{
+  uint64_t frames_allocated;  // number of frames that had to be allocated because the pool had no matching frame
+  uint64_t frames_reused;     // number of frames that were taken from the pool
+  uint64_t frames_discarded;  // number of released frames that were deleted because the pool was full
+  size_t frames_in_pool;      // number of idle frames currently held in the pool
+  size_t bytes_in_pool;       // plane memory held by the idle frames
+  size_t high_water_mark;     // maximum number of idle frames
+};
+
+/**
+ * Each input recycles the frames released by vidio_input_pop_next_frame() for the next captured frames
+ * with the same format, size and plane layout. This avoids allocating new plane memory for each frame.
+ *
+ * @param input The input.
+ * @param out_stats Receives the current pool statistics.
+ */
+LIBVIDIO_API void vidio_input_get_frame_pool_statistics(const struct vidio_input* input,
+                                                        struct vidio_frame_pool_statistics* out_stats);
+
+/**
+ * Set the maximum number of idle frames that are kept for reuse.
+ * Frames released beyond this limit are deleted. Set to 0 to disable frame recycling.
+ *
+ * @param input The input.
+ * @param max_frames Maximum number of idle frames (default: 8).
+ */
+LIBVIDIO_API void vidio_input_set_frame_pool_high_water_mark(struct vidio_input* input, size_t max_frames);
+
+struct vidio_input_drop_statistics
+{
+  uint64_t driver_dropped_frames;  // frames skipped by the driver (gaps in the V4L2 sequence numbers), e.g. because all buffers were in use
+  uint64_t queue_dropped_frames;   // captured frames that were discarded because the input queue was full
+};
+
+/**
+ * Get the number of frames that were lost since the input was created.
+ * Driver drops point to the camera, the bus or too few capture buffers. Queue drops mean that the application
+ * did not pop the frames fast enough. Frames replaced in the latest-frame delivery mode are not counted here,
+ * see vidio_input_get_superseded_frame_count().
+ *
+ * @param input The input.
+ * @param out_stats Receives the counters.
+ */
+LIBVIDIO_API void vidio_input_get_drop_statistics(const struct vidio_input* input,
+                                                  struct vidio_input_drop_statistics* out_stats);
+
+
+// === V4L2 Input ===
+
+/**
+ * Enable or disable zero-copy capturing for V4L2 inputs.
+ * Must be called before starting capture.
+ *
+ * In zero-copy mode, the frames returned by vidio_input_peek_next_frame() directly reference the
+ * memory-mapped V4L2 capture buffers instead of a copy. The buffer is only handed back to the driver
+ * when the frame is removed with vidio_input_pop_next_frame() and all clones of the frame have been freed.
+ * Since the driver only has a few buffers, frames should be released quickly, or the camera will drop frames.
+ * Use vidio_frame_copy() to keep a frame for a longer time.
+ * Frames may outlive the input. The buffer memory then stays valid until the frame is freed, but is not re-queued.
+ *
+ * @param input The V4L2 input. For other input types, this function does nothing.
+ * @param enable Whether to use zero-copy capturing (default: off).
+ */
+LIBVIDIO_API void vidio_v4l_set_zero_copy(struct vidio_input* input, vidio_bool enable);
+
+/**
+ * Export the V4L2 capture buffers as dmabufs, so that frames can be passed to hardware encoders,
+ * GPUs, or other processes without copying. See vidio_frame_get_dmabuf().
+ * This implies zero-copy capturing (see vidio_v4l_set_zero_copy()).
+ * Must be called before starting capture. Capturing fails to start if the driver cannot export its buffers.
+ *
+ * @param input The V4L2 input. For other input types, this function does nothing.
+ * @param enable Whether to export the capture buffers (default: off).
+ */
+LIBVIDIO_API void vidio_v4l_set_export_dmabuf(struct vidio_input* input, vidio_bool enable);
+
+/**
+ * Memory allocator for V4L2 capture buffers in user-pointer mode (see vidio_v4l_set_userptr_mode()).
+ */
+struct vidio_v4l_userptr_allocator
+{
+  // Must return memory that is aligned to the page size. 'size' is already a multiple of the page size.
+  void* (*allocate)(size_t size, void* user_data);
+
+  // Called when the buffer is not used by libvidio anymore, i.e. after capturing stopped and all frames
+  // referencing the buffer have been freed.
+  void (*release)(void* mem, size_t size, void* user_data);
+
+  void* user_data;
+};
+
+/**
+ * Let the V4L2 driver write the captured images directly into memory provided by libvidio or by the application
+ * (V4L2_MEMORY_USERPTR) instead of into driver-allocated buffers. The captured frames reference this memory
+ * without a copy. With an application allocator, frames can be captured directly into shared memory, for example.
+ * This implies zero-copy capturing (see vidio_v4l_set_zero_copy()) and cannot be combined with dmabuf export.
+ * Must be called before starting capture. Not all drivers support this mode.
+ *
+ * @param input The V4L2 input. For other input types, this function does nothing.
+ * @param enable Whether to use user-pointer buffers (default: off).
+ * @param allocator The allocator for the capture buffers. The struct is copied.
+ *                  NULL to let libvidio allocate page-aligned memory.
+ */
+LIBVIDIO_API void vidio_v4l_set_userptr_mode(struct vidio_input* input, vidio_bool enable,
+                                             const struct vidio_v4l_userptr_allocator* allocator);
+
+/**
+ * Set the number of capture buffers that are requested from the V4L2 driver.
+ * Must be called before starting capture.
+ *
+ * More buffers allow the consumer to stall for a longer time before the camera drops frames,
+ * but each buffer holds a full frame. The driver may choose a different number of buffers.
+ *
+ * When max_count is larger than count, the buffer count is adaptive: whenever the driver had to drop frames
+ * because all buffers were in use (detected from gaps in the frame sequence numbers), another buffer is added,
+ * up to max_count. Not all drivers support adding buffers while capturing.
+ *
+ * @param input The V4L2 input. For other input types, an error is returned.
+ * @param count Initial number of buffers (default: 4). Must be at least 2.
+ * @param max_count Maximum number of buffers in adaptive mode. Pass 0 to disable the adaptive mode.
+ */
+LIBVIDIO_API const struct vidio_error* vidio_v4l_set_buffer_count(struct vidio_input* input, uint32_t count, uint32_t max_count);
+
+/**
+ * Get the number of capture buffers that are currently allocated.
+ * This can be larger than the initial count when the adaptive mode added buffers.
+ *
+ * @return The number of buffers, or 0 when the input is not capturing or not a V4L2 input.
+ */
+LIBVIDIO_API uint32_t vidio_v4l_get_buffer_count(const struct vidio_input* input);
+
+/**
+ * Create another input for the same V4L2 camera that captures from one of its other device nodes at the same time.
+ * For example, record the H.264 stream of a UVC camera while analysing its MJPEG stream, without transcoding.
+ * The new input has its own frame queue and settings, and it is configured, started and stopped independently.
+ *
+ * A device node can only be captured by one of the inputs of a camera. vidio_input_get_video_formats() does not
+ * list the formats of nodes that are already used by another input of the same camera.
+ *
+ * @param input A V4L2 input device. For other input types, an error is returned.
+ * @param out_stream Receives the new input. Release it with vidio_input_release().
+ */
+LIBVIDIO_API const struct vidio_error* vidio_v4l_create_additional_stream(const struct vidio_input* input,
+                                                                          struct vidio_input** out_stream);
+
+/**
+ * Serve all capturing V4L2 inputs from a shared pool of threads instead of one capturing thread per input.
+ * The threads wait on all capturing devices at once (epoll) and take whichever device has a frame ready.
+ * This reduces the number of threads and context switches when many cameras are captured at the same time.
+ *
+ * The setting applies to inputs that start capturing afterwards. Additional threads are started when the
+ * next input starts capturing. The threads are kept until the library is unloaded, so reducing the number
+ * does not stop running threads.
+ * With shared threads, a capture error ends the stream of that input with 'vidio_input_message_end_of_stream'.
+ * The overflow policy 'vidio_overflow_policy_block' behaves like 'vidio_overflow_policy_drop_newest'.
+ *
+ * @param num_threads Number of shared capturing threads. 0 (default) uses one thread per input.
+ */
+LIBVIDIO_API void vidio_v4l_set_reactor_threads(int num_threads);
+
 
 // === RTSP Input ===
 
@@ -22,6 +22,7 @@
 #define LIBVIDIO_VIDIO_CAPTURING_LOOP_H
 
 #include <libvidio/vidio.h>
+#include <atomic>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
@@ -45,6 +46,10 @@ public:
   // Those are handled by the two callbacks above.
   void set_on_stream_message(std::function<void(vidio_input_message)> f) { m_on_stream_message = std::move(f); }
 
+  // With 'vidio_delivery_mode_latest_frame', the callback always receives the newest frame and skips frames
+  // that were captured while the previous callback was running. Must be set before starting.
+  void set_delivery_mode(vidio_delivery_mode mode) { m_delivery_mode = mode; }
+
   enum class run_mode {
     async,
     sync
@@ -62,6 +67,7 @@ public:
     // start vidio input
 
     vidio_input_set_message_callback(m_input, on_vidio_message, this);
+    vidio_input_set_delivery_mode(m_input, m_delivery_mode);
 
     auto* err = vidio_input_start_capturing(m_input);
     if (err) {
@@ -83,7 +89,7 @@ public:
   void stop()
   {
     m_active = false;
-    m_cond.notify_one();
+    wake_up();
 
     if (m_mode == run_mode::async) {
       m_thread.join();
@@ -92,13 +98,17 @@ public:
 
 private:
   vidio_input* m_input;
-  bool m_active = false;
+  std::atomic<bool> m_active{false};
   run_mode m_mode;
+  vidio_delivery_mode m_delivery_mode = vidio_delivery_mode_queue;
 
   std::thread m_thread;
   std::mutex m_mutex;
   std::condition_variable m_cond;
 
+  // Set while the loop sleeps on m_cond. The capturing thread only takes the mutex to wake it up when this is set.
+  std::atomic<bool> m_waiting{false};
+
   std::function<void(const vidio_frame*)> m_on_frame_received;
   std::function<void()> m_on_stream_ended;
   std::function<void(vidio_input_message)> m_on_stream_message;
@@ -111,15 +121,21 @@ private:
       bool active;
       bool haveStopped = false;
 
-      {
+      if (vidio_input_peek_next_frame(m_input) == nullptr) {
         std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_waiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
         while (vidio_input_peek_next_frame(m_input) == nullptr && m_active) {
           m_cond.wait(lock);
         }
 
-        active = m_active;
+        m_waiting = false;
       }
 
+      active = m_active;
+
       if (!active) {
         // stop the input capturing. We will still process the frames that remain in the input queue.
         vidio_input_stop_capturing(m_input);
@@ -152,17 +168,28 @@ private:
     }
   }
 
+  void wake_up()
+  {
+    // Pairs with the fence in loop(): either the loop sees the new frame, or we see that it is waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (m_waiting) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_cond.notify_one();
+    }
+  }
+
   static void on_vidio_message(vidio_input_message msg, void* userData)
   {
     auto* me = static_cast<vidio_capturing_loop*>(userData);
 
     if (msg == vidio_input_message_new_frame) {
-      me->m_cond.notify_one();
+      me->wake_up();
     }
     else if (msg == vidio_input_message_end_of_stream) {
       if (me->m_active) {
         me->m_active = false;
-        me->m_cond.notify_one();
+        me->wake_up();
       }
     }
     else {
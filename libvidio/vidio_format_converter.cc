@@ -19,6 +19,7 @@
  */
 
 #include "vidio_format_converter.h"
+#include "vidio_error.h"
 #include "colorconversion/yuv2rgb.h"
 #include "colorconversion/mjpeg.h"
 #include "colorconversion/ffmpeg.h"
@@ -27,46 +28,62 @@
 struct vidio_format_converter_function : public vidio_format_converter
 {
 public:
-  explicit vidio_format_converter_function(vidio_frame* (* func)(const vidio_frame*)) { m_func = func; }
+  explicit vidio_format_converter_function(vidio_frame* (* func)(const vidio_frame*, int num_threads)) { m_func = func; }
 
   void push(const vidio_frame* f) override
   {
-    auto* out = m_func(f);
+    auto* out = m_func(f, m_num_threads);
     push_decoded_frame(out);
   }
 
 private:
-  vidio_frame* (* m_func)(const vidio_frame*);
+  vidio_frame* (* m_func)(const vidio_frame*, int num_threads);
 };
 
 
 vidio_format_converter* vidio_format_converter::create(vidio_pixel_format in, vidio_pixel_format out)
 {
-  if (in == vidio_pixel_format_MJPEG) {
-    //return new vidio_format_converter_function(mjpeg_to_rgb8_ffmpeg);
-    auto* converter = new vidio_format_converter_ffmpeg();
-    converter->init(AV_CODEC_ID_MJPEG, out);
-    return converter;
+  enum AVCodecID codec;
+
+  switch (in) {
+    case vidio_pixel_format_MJPEG:
+      codec = AV_CODEC_ID_MJPEG;
+      break;
+    case vidio_pixel_format_H264:
+      codec = AV_CODEC_ID_H264;
+      break;
+    case vidio_pixel_format_H265:
+      codec = AV_CODEC_ID_H265;
+      break;
+    default:
+      codec = AV_CODEC_ID_NONE;
+      break;
   }
-  else if (in == vidio_pixel_format_H264) {
-    //return new vidio_format_converter_function(mjpeg_to_rgb8_ffmpeg);
+
+  if (codec != AV_CODEC_ID_NONE) {
     auto* converter = new vidio_format_converter_ffmpeg();
-    converter->init(AV_CODEC_ID_H264, out);
+    auto* err = converter->init(codec, out);
+    if (err) {
+      delete err;
+      delete converter;
+      return nullptr;
+    }
+
     return converter;
   }
-  else if (in == vidio_pixel_format_H265) {
-    //return new vidio_format_converter_function(mjpeg_to_rgb8_ffmpeg);
-    auto* converter = new vidio_format_converter_ffmpeg();
-    converter->init(AV_CODEC_ID_H265, out);
-    return converter;
+
+  // Our own SIMD kernels for the most common conversions, swscale for everything else.
+
+  if (in == vidio_pixel_format_YUV422_YUYV && out == vidio_pixel_format_RGB8) {
+    return new vidio_format_converter_function(yuyv_to_rgb8);
   }
-  else {
-    //return new vidio_format_converter_function(yuyv_to_rgb8);
+  else if (in == vidio_pixel_format_YUV420_planar && out == vidio_pixel_format_RGB8) {
+    return new vidio_format_converter_function(yuv420_to_rgb8);
+  }
+  else if (vidio_format_converter_swscale::supports(in, out)) {
     return new vidio_format_converter_swscale(out);
   }
-  /*
   else {
     return nullptr;
   }
-  */
 }
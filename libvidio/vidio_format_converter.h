@@ -53,6 +53,11 @@ public:
 
   static vidio_format_converter* create(vidio_pixel_format in, vidio_pixel_format out);
 
+  // Number of threads that convert horizontal slices of a frame in parallel. 0 means one per CPU core.
+  void set_num_threads(int num_threads) { m_num_threads = num_threads; }
+
+  int get_num_threads() const { return m_num_threads; }
+
 private:
   mutable std::mutex m_mutex;
   std::deque<vidio_frame*> m_output_queue;
@@ -65,6 +70,8 @@ protected:
   }
 
   vidio_format_converter() = default;
+
+  int m_num_threads = 1;
 };
 
 
@@ -23,13 +23,19 @@
 #include <cstring>
 
 
-vidio_frame::~vidio_frame()
+vidio_frame::~vidio_frame() = default;
+
+
+static std::shared_ptr<uint8_t> new_plane_memory(size_t size)
 {
-  for (auto& plane : m_planes) {
-    if (plane.second.memory_owned) {
-      delete[] plane.second.mem;
-    }
-  }
+  return std::shared_ptr<uint8_t>(new uint8_t[size], std::default_delete<uint8_t[]>());
+}
+
+
+static std::shared_ptr<uint8_t> wrap_external_plane_memory(uint8_t* mem, std::shared_ptr<void> owner)
+{
+  // Each plane gets its own reference count, so that use_count() tells whether this plane is shared with another frame.
+  return std::shared_ptr<uint8_t>(mem, [owner](uint8_t*) {});
 }
 
 
@@ -59,7 +65,8 @@ void vidio_frame::add_raw_plane(vidio_color_channel channel, int bpp)
       break;
 
     case vidio_color_channel_U:
-    case vidio_color_channel_V: {
+    case vidio_color_channel_V:
+    case vidio_color_channel_UV: {
       int cw = 0, ch = 0;
       get_chroma_size(cw, ch);
       add_raw_plane(channel, cw, ch, bpp);
@@ -78,6 +85,10 @@ void vidio_frame::get_chroma_size(int& cw, int& ch) const
     case vidio_pixel_format_H264:
     case vidio_pixel_format_H265:
     case vidio_pixel_format_RGGB8:
+    case vidio_pixel_format_BGR8:
+    case vidio_pixel_format_RGBA8:
+    case vidio_pixel_format_BGRA8:
+    case vidio_pixel_format_GREY8:
       assert(false);
       cw = ch = 0;
       return;
@@ -88,6 +99,18 @@ void vidio_frame::get_chroma_size(int& cw, int& ch) const
       break;
 
     case vidio_pixel_format_YUV422_YUYV:
+    case vidio_pixel_format_YUV422_UYVY:
+      cw = (m_width + 1) / 2;
+      ch = m_height;
+      break;
+
+    case vidio_pixel_format_YUV420_NV12:
+    case vidio_pixel_format_YUV420_NV21:
+      cw = (m_width + 1) / 2;
+      ch = (m_height + 1) / 2;
+      break;
+
+    case vidio_pixel_format_YUV422_NV16:
       cw = (m_width + 1) / 2;
       ch = m_height;
       break;
@@ -95,6 +118,27 @@ void vidio_frame::get_chroma_size(int& cw, int& ch) const
 }
 
 
+void vidio_frame::allocate_plane_memory(vidio_color_channel channel, Plane& plane, size_t size)
+{
+  // Reuse the memory of a recycled frame if it is large enough.
+
+  auto iter = m_recycled_planes.find(channel);
+  if (iter != m_recycled_planes.end()) {
+    Plane recycled = std::move(iter->second);
+    m_recycled_planes.erase(iter);
+
+    if (recycled.capacity >= size) {
+      plane.mem = std::move(recycled.mem);
+      plane.capacity = recycled.capacity;
+      return;
+    }
+  }
+
+  plane.mem = new_plane_memory(size);
+  plane.capacity = size;
+}
+
+
 static int align_up(int w, int stride)
 {
   if ((w % stride) == 0) {
@@ -120,14 +164,14 @@ void vidio_frame::add_raw_plane(vidio_color_channel channel, int w, int h, int b
   p.format = vidio_channel_format_pixels;
   p.bpp = bpp;
 
-  p.mem = new uint8_t[memWidth * h];
-  p.memory_owned = true;
+  allocate_plane_memory(channel, p, size_t(memWidth) * h);
 
   m_planes[channel] = p;
 }
 
 void vidio_frame::add_external_raw_plane(vidio_color_channel channel,
-                                         uint8_t* mem, int w, int h, int bpp, int stride)
+                                         uint8_t* mem, int w, int h, int bpp, int stride,
+                                         std::shared_ptr<void> owner)
 {
   assert(m_planes.find(channel) == m_planes.end());
 
@@ -136,8 +180,8 @@ void vidio_frame::add_external_raw_plane(vidio_color_channel channel,
   p.h = h;
   p.stride = stride;
   p.format = vidio_channel_format_pixels;
-  p.mem = mem;
-  p.memory_owned = false;
+  p.bpp = bpp;
+  p.mem = wrap_external_plane_memory(mem, std::move(owner));
 
   m_planes[channel] = p;
 }
@@ -154,9 +198,26 @@ void vidio_frame::add_compressed_plane(vidio_color_channel channel,
   p.stride = memorySize;
   p.format = format;
   p.bpp = bpp;
-  p.mem = new uint8_t[memorySize];
-  p.memory_owned = true;
-  memcpy(p.mem, mem, memorySize);
+  allocate_plane_memory(channel, p, memorySize);
+  memcpy(p.mem.get(), mem, memorySize);
+
+  m_planes[channel] = p;
+}
+
+void vidio_frame::add_external_compressed_plane(vidio_color_channel channel,
+                                                vidio_channel_format format, int bpp,
+                                                uint8_t* mem, int memorySize, int w, int h,
+                                                std::shared_ptr<void> owner)
+{
+  assert(m_planes.find(channel) == m_planes.end());
+
+  Plane p;
+  p.w = w;
+  p.h = h;
+  p.stride = memorySize;
+  p.format = format;
+  p.bpp = bpp;
+  p.mem = wrap_external_plane_memory(mem, std::move(owner));
 
   m_planes[channel] = p;
 }
@@ -166,13 +227,34 @@ bool vidio_frame::has_plane(vidio_color_channel channel) const
   return m_planes.find(channel) != m_planes.end();
 }
 
+void vidio_frame::make_plane_writable(Plane& plane)
+{
+  // If no other frame references the memory, nobody else can start sharing it while we are writing to it.
+  if (plane.mem.use_count() <= 1) {
+    return;
+  }
+
+  size_t size = plane.memory_size();
+  auto copy = new_plane_memory(size);
+  memcpy(copy.get(), plane.mem.get(), size);
+  plane.mem = std::move(copy);
+  plane.capacity = size;
+
+  // The frame does not reference the dmabuf memory anymore.
+  m_dmabuf = dmabuf{};
+}
+
 uint8_t* vidio_frame::get_plane(vidio_color_channel channel, int* stride)
 {
-  assert(has_plane(channel));
+  auto iter = m_planes.find(channel);
+
+  assert(iter != m_planes.end());
   assert(stride);
 
-  *stride = m_planes[channel].stride;
-  return m_planes[channel].mem;
+  make_plane_writable(iter->second);
+
+  *stride = iter->second.stride;
+  return iter->second.mem.get();
 }
 
 const uint8_t* vidio_frame::get_plane(vidio_color_channel channel, int* stride) const
@@ -183,7 +265,18 @@ const uint8_t* vidio_frame::get_plane(vidio_color_channel channel, int* stride)
   assert(stride);
 
   *stride = iter->second.stride;
-  return iter->second.mem;
+  return iter->second.mem.get();
+}
+
+
+size_t vidio_frame::get_memory_size() const
+{
+  size_t size = 0;
+  for (const auto& [channel, plane] : m_planes) {
+    size += plane.memory_size();
+  }
+
+  return size;
 }
 
 
@@ -192,14 +285,31 @@ void vidio_frame::copy_raw_plane(vidio_color_channel channel, const void* mem, s
   auto iter = m_planes.find(channel);
   assert(iter != m_planes.end());
 
+  int bytes_per_pixel = (iter->second.bpp + 7) / 8;
+  copy_raw_plane(channel, mem, length, iter->second.w * bytes_per_pixel);
+}
+
+
+void vidio_frame::copy_raw_plane(vidio_color_channel channel, const void* mem, size_t length, int src_stride)
+{
+  auto iter = m_planes.find(channel);
+  assert(iter != m_planes.end());
+
   auto& plane = iter->second;
+  make_plane_writable(plane);
 
   int bytes_per_pixel = (plane.bpp + 7) / 8;
+  size_t row_bytes = size_t(plane.w) * bytes_per_pixel;
 
   for (int y = 0; y < plane.h; y++) {
-    memcpy(plane.mem + y * plane.stride,
-           ((uint8_t*) mem) + y * plane.w * bytes_per_pixel,
-           plane.w * bytes_per_pixel);
+    // do not read beyond the end of the source, e.g. when a driver delivered a truncated frame
+    if (size_t(y) * src_stride + row_bytes > length) {
+      break;
+    }
+
+    memcpy(plane.mem.get() + y * plane.stride,
+           ((const uint8_t*) mem) + size_t(y) * src_stride,
+           row_bytes);
   }
 }
 
@@ -210,6 +320,13 @@ void vidio_frame::copy_metadata_from(const vidio_frame* source)
   m_is_keyframe = source->is_keyframe();
   m_has_dts = source->has_dts();
   m_dts_us = source->get_dts_us();
+  m_clock_domain = source->get_clock_domain();
+  m_timestamp_source = source->get_timestamp_source();
+  m_dequeue_timestamp_us = source->get_dequeue_timestamp_us();
+  m_has_sequence_number = source->has_sequence_number();
+  m_sequence_number = source->get_sequence_number();
+  m_color_matrix = source->get_color_matrix();
+  m_color_range = source->get_color_range();
   if (source->has_codec_extradata()) {
     set_codec_extradata(source->get_codec_extradata(), source->get_codec_extradata_size());
   }
@@ -227,7 +344,27 @@ void vidio_frame::set_codec_extradata(const uint8_t* data, int size)
 }
 
 
+void vidio_frame::set_dmabuf(int fd, size_t offset, size_t size, std::shared_ptr<void> owner)
+{
+  m_dmabuf.fd = fd;
+  m_dmabuf.offset = offset;
+  m_dmabuf.size = size;
+  m_dmabuf.owner = std::move(owner);
+}
+
+
 vidio_frame* vidio_frame::clone() const
+{
+  auto* f = new vidio_frame();
+  f->set_format(m_format, m_width, m_height);
+  f->m_planes = m_planes;
+  f->m_dmabuf = m_dmabuf;
+  f->copy_metadata_from(this);
+  return f;
+}
+
+
+vidio_frame* vidio_frame::deep_copy() const
 {
   auto* f = new vidio_frame();
   f->set_format(m_format, m_width, m_height);
@@ -240,13 +377,13 @@ vidio_frame* vidio_frame::clone() const
       int bytes_per_pixel = (plane.bpp + 7) / 8;
       int row_bytes = plane.w * bytes_per_pixel;
       for (int y = 0; y < plane.h; y++) {
-        memcpy(dst + y * dst_stride, plane.mem + y * plane.stride, row_bytes);
+        memcpy(dst + y * dst_stride, plane.mem.get() + y * plane.stride, row_bytes);
       }
     }
     else {
       // Compressed plane: stride holds memory size
       f->add_compressed_plane(channel, plane.format, plane.bpp,
-                              plane.mem, plane.stride,
+                              plane.mem.get(), plane.stride,
                               plane.w, plane.h);
     }
   }
@@ -254,3 +391,54 @@ vidio_frame* vidio_frame::clone() const
   f->copy_metadata_from(this);
   return f;
 }
+
+
+void vidio_frame::recycle()
+{
+  m_recycled_planes.clear();
+
+  for (auto& [channel, plane] : m_planes) {
+    // Keep only memory that we allocated ourselves and that is not shared with a clone.
+    if (plane.capacity > 0 && plane.mem.use_count() == 1) {
+      m_recycled_planes[channel] = std::move(plane);
+    }
+  }
+
+  m_planes.clear();
+
+  m_timestamp_us = 0;
+  m_is_keyframe = true;
+  m_has_dts = false;
+  m_dts_us = 0;
+  m_clock_domain = vidio_clock_domain_unknown;
+  m_timestamp_source = vidio_timestamp_source_unknown;
+  m_dequeue_timestamp_us = 0;
+  m_has_sequence_number = false;
+  m_sequence_number = 0;
+  m_color_matrix = vidio_color_matrix_unknown;
+  m_color_range = vidio_color_range_unknown;
+  m_codec_extradata.clear();
+  m_dmabuf = dmabuf{};
+}
+
+
+size_t vidio_frame::get_recycled_memory_size() const
+{
+  size_t size = 0;
+  for (const auto& [channel, plane] : m_recycled_planes) {
+    size += plane.capacity;
+  }
+
+  return size;
+}
+
+
+vidio_frame::plane_layout vidio_frame::get_plane_layout() const
+{
+  plane_layout layout;
+  for (const auto& [channel, plane] : m_planes) {
+    layout.emplace_back(channel, plane.format, plane.w, plane.h, plane.bpp);
+  }
+
+  return layout;
+}
@@ -24,6 +24,8 @@
 #include "vidio.h"
 #include <map>
 #include <vector>
+#include <memory>
+#include <tuple>
 
 
 struct vidio_frame
@@ -41,14 +43,25 @@ public:
 
   void copy_raw_plane(vidio_color_channel channel, const void* mem, size_t length);
 
+  // Like above, but the rows of the source memory are 'src_stride' bytes apart.
+  void copy_raw_plane(vidio_color_channel channel, const void* mem, size_t length, int src_stride);
+
   // vidio_frame will reuse the existing memory. It has to remain allocated while used.
+  // If an 'owner' is given, it is kept alive until the last frame referencing the plane is released.
   void add_external_raw_plane(vidio_color_channel channel,
-                              uint8_t* mem, int w, int h, int bpp, int stride);
+                              uint8_t* mem, int w, int h, int bpp, int stride,
+                              std::shared_ptr<void> owner = nullptr);
 
   void add_compressed_plane(vidio_color_channel channel,
                             vidio_channel_format format, int bpp,
                             const uint8_t* mem, int memorySize, int w, int h);
 
+  // Like add_external_raw_plane(), the memory is not copied and has to remain allocated while used.
+  void add_external_compressed_plane(vidio_color_channel channel,
+                                     vidio_channel_format format, int bpp,
+                                     uint8_t* mem, int memorySize, int w, int h,
+                                     std::shared_ptr<void> owner = nullptr);
+
   int get_width() const { return m_width; }
 
   int get_height() const { return m_height; }
@@ -61,6 +74,9 @@ public:
 
   const uint8_t* get_plane(vidio_color_channel, int* stride) const;
 
+  // Memory size of all planes.
+  size_t get_memory_size() const;
+
   // --- metadata ---
 
   void copy_metadata_from(const vidio_frame* source);
@@ -83,6 +99,39 @@ public:
 
   int64_t get_dts_us() const { return m_dts_us; }
 
+  // --- clock domain ---
+
+  // The clock that get_timestamp_us() (and get_dts_us()) refer to.
+  void set_clock_domain(vidio_clock_domain domain) { m_clock_domain = domain; }
+
+  vidio_clock_domain get_clock_domain() const { return m_clock_domain; }
+
+  void set_timestamp_source(vidio_timestamp_source source) { m_timestamp_source = source; }
+
+  vidio_timestamp_source get_timestamp_source() const { return m_timestamp_source; }
+
+  // CLOCK_MONOTONIC time at which the frame was taken from the driver (or demuxer). 0 if not set.
+  void set_dequeue_timestamp_us(uint64_t ts) { m_dequeue_timestamp_us = ts; }
+
+  uint64_t get_dequeue_timestamp_us() const { return m_dequeue_timestamp_us; }
+
+  // --- sequence number ---
+
+  // Frame counter of the driver (V4L2). Gaps indicate frames that were dropped by the driver.
+  void set_sequence_number(uint32_t sequence) { m_sequence_number = sequence; m_has_sequence_number = true; }
+
+  bool has_sequence_number() const { return m_has_sequence_number; }
+
+  uint32_t get_sequence_number() const { return m_sequence_number; }
+
+  // --- colorimetry (YUV formats only) ---
+
+  void set_colorimetry(vidio_color_matrix matrix, vidio_color_range range) { m_color_matrix = matrix; m_color_range = range; }
+
+  vidio_color_matrix get_color_matrix() const { return m_color_matrix; }
+
+  vidio_color_range get_color_range() const { return m_color_range; }
+
   // --- codec extradata (SPS/PPS/VPS for H264/H265) ---
 
   void set_codec_extradata(const uint8_t* data, int size);
@@ -93,10 +142,43 @@ public:
 
   int get_codec_extradata_size() const { return static_cast<int>(m_codec_extradata.size()); }
 
+  // --- dmabuf ---
+
+  // The frame data is also available as a dmabuf (Linux DMA buffer sharing).
+  // The fd stays open as long as 'owner' is alive. The frame does not close the fd itself.
+  // The dmabuf is dropped when the frame data is modified or deep-copied, since it then does not match anymore.
+  void set_dmabuf(int fd, size_t offset, size_t size, std::shared_ptr<void> owner);
+
+  bool has_dmabuf() const { return m_dmabuf.fd != -1; }
+
+  int get_dmabuf_fd() const { return m_dmabuf.fd; }
+
+  size_t get_dmabuf_offset() const { return m_dmabuf.offset; }
+
+  size_t get_dmabuf_size() const { return m_dmabuf.size; }
+
   // --- clone ---
 
+  // Shallow copy. The plane memory is shared with this frame and only copied on write access.
   vidio_frame* clone() const;
 
+  // Copies all planes into memory owned by the new frame.
+  vidio_frame* deep_copy() const;
+
+  // --- recycling (see vidio_frame_pool) ---
+
+  // Removes all planes and metadata. Plane memory that is owned exclusively by this frame is kept
+  // and reused by the next add_raw_plane() / add_compressed_plane() with a matching layout.
+  void recycle();
+
+  size_t get_recycled_memory_size() const;
+
+  // Channel, channel format, width, height and bits per pixel of each plane, ordered by channel.
+  // Frames with the same plane layout allocate planes of the same size.
+  using plane_layout = std::vector<std::tuple<vidio_color_channel, vidio_channel_format, int, int, int>>;
+
+  plane_layout get_plane_layout() const;
+
 private:
   int m_width = 0, m_height = 0;
   vidio_pixel_format m_format = vidio_pixel_format_undefined;
@@ -108,18 +190,49 @@ private:
     vidio_channel_format format = vidio_channel_format_undefined;
     int bpp=0;
 
-    uint8_t* mem = nullptr;
-    bool memory_owned = false;
+    // Shared between cloned frames. For external memory, the deleter does not free the memory,
+    // but only releases the reference to its owner.
+    std::shared_ptr<uint8_t> mem;
+
+    // Size of the memory allocated by the frame. 0 for external memory.
+    size_t capacity = 0;
+
+    size_t memory_size() const { return format == vidio_channel_format_pixels ? size_t(stride) * h : size_t(stride); }
   };
 
+  // Makes sure that the plane memory is not shared with another frame before it is written to.
+  void make_plane_writable(Plane& plane);
+
   std::map<vidio_color_channel, Plane> m_planes;
 
+  // Planes of a recycled frame, waiting to be reused.
+  std::map<vidio_color_channel, Plane> m_recycled_planes;
+
+  void allocate_plane_memory(vidio_color_channel channel, Plane& plane, size_t size);
+
   uint64_t m_timestamp_us = 0;
   bool m_is_keyframe = true;  // default true: uncompressed frames are always independently decodable
   bool m_has_dts = false;
   int64_t m_dts_us = 0;
+  vidio_clock_domain m_clock_domain = vidio_clock_domain_unknown;
+  vidio_timestamp_source m_timestamp_source = vidio_timestamp_source_unknown;
+  uint64_t m_dequeue_timestamp_us = 0;
+  bool m_has_sequence_number = false;
+  uint32_t m_sequence_number = 0;
+  vidio_color_matrix m_color_matrix = vidio_color_matrix_unknown;
+  vidio_color_range m_color_range = vidio_color_range_unknown;
   std::vector<uint8_t> m_codec_extradata;
 
+  struct dmabuf
+  {
+    int fd = -1;
+    size_t offset = 0;
+    size_t size = 0;
+    std::shared_ptr<void> owner;
+  };
+
+  dmabuf m_dmabuf;
+
   void get_chroma_size(int& cw, int& ch) const;
 
   static const int cDefaultStride = 16;
@@ -0,0 +1,148 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "vidio_frame_pool.h"
+#include "vidio_frame.h"
+
+
+vidio_frame_pool::~vidio_frame_pool()
+{
+  clear();
+}
+
+
+vidio_frame* vidio_frame_pool::acquire_frame(vidio_pixel_format format, int w, int h,
+                                             const vidio_frame::plane_layout& layout)
+{
+  vidio_frame* frame = nullptr;
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto iter = m_idle_frames.find(key{format, w, h, layout});
+    if (iter != m_idle_frames.end() && !iter->second.empty()) {
+      frame = iter->second.back();
+      iter->second.pop_back();
+
+      m_frames_in_pool--;
+      m_bytes_in_pool -= frame->get_recycled_memory_size();
+      m_frames_reused++;
+    }
+    else {
+      m_frames_allocated++;
+    }
+  }
+
+  if (!frame) {
+    frame = new vidio_frame();
+  }
+
+  frame->set_format(format, w, h);
+  return frame;
+}
+
+
+void vidio_frame_pool::release_frame(const vidio_frame* const_frame)
+{
+  if (!const_frame) {
+    return;
+  }
+
+  // The pool owns the frame now. Nobody else has access to it anymore.
+  auto* frame = const_cast<vidio_frame*>(const_frame);
+
+  key frame_key{frame->get_pixel_format(), frame->get_width(), frame->get_height(), frame->get_plane_layout()};
+
+  // Drop the metadata and all references to shared or external plane memory before the frame is parked.
+  // This also releases zero-copy capture buffers.
+  frame->recycle();
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if (m_frames_in_pool >= m_high_water_mark) {
+    m_frames_discarded++;
+    lock.unlock();
+
+    delete frame;
+    return;
+  }
+
+  m_idle_frames[std::move(frame_key)].push_back(frame);
+  m_frames_in_pool++;
+  m_bytes_in_pool += frame->get_recycled_memory_size();
+}
+
+
+void vidio_frame_pool::set_high_water_mark(size_t max_frames)
+{
+  std::vector<vidio_frame*> excess_frames;
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_high_water_mark = max_frames;
+
+    for (auto& [k, frames] : m_idle_frames) {
+      while (!frames.empty() && m_frames_in_pool > m_high_water_mark) {
+        vidio_frame* frame = frames.back();
+        frames.pop_back();
+
+        m_frames_in_pool--;
+        m_bytes_in_pool -= frame->get_recycled_memory_size();
+        excess_frames.push_back(frame);
+      }
+    }
+  }
+
+  for (auto* frame : excess_frames) {
+    delete frame;
+  }
+}
+
+
+void vidio_frame_pool::get_statistics(struct vidio_frame_pool_statistics* out_stats) const
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  out_stats->frames_allocated = m_frames_allocated;
+  out_stats->frames_reused = m_frames_reused;
+  out_stats->frames_discarded = m_frames_discarded;
+  out_stats->frames_in_pool = m_frames_in_pool;
+  out_stats->bytes_in_pool = m_bytes_in_pool;
+  out_stats->high_water_mark = m_high_water_mark;
+}
+
+
+void vidio_frame_pool::clear()
+{
+  std::map<key, std::vector<vidio_frame*>> idle_frames;
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    idle_frames.swap(m_idle_frames);
+    m_frames_in_pool = 0;
+    m_bytes_in_pool = 0;
+  }
+
+  for (auto& [k, frames] : idle_frames) {
+    for (auto* frame : frames) {
+      delete frame;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVIDIO_VIDIO_FRAME_POOL_H
+#define LIBVIDIO_VIDIO_FRAME_POOL_H
+
+#include <libvidio/vidio.h>
+#include "vidio_frame.h"
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+
+
+// Recycles the frames (and their plane memory) of an input.
+// Frames are returned to the pool when they are popped from the input queue. The next frame with the same
+// format, size and plane layout reuses the frame object and its plane buffers.
+class vidio_frame_pool
+{
+public:
+  ~vidio_frame_pool();
+
+  // Returns a frame with the format set, but without planes.
+  // 'layout' describes the planes that the caller is going to add. A recycled frame is only taken from the
+  // pool if it had the same planes, such that add_raw_plane() or add_compressed_plane() can reuse its memory.
+  vidio_frame* acquire_frame(vidio_pixel_format format, int w, int h, const vidio_frame::plane_layout& layout);
+
+  // Takes ownership of the frame. If the pool is full, the frame is deleted.
+  void release_frame(const vidio_frame* frame);
+
+  // Maximum number of idle frames kept in the pool.
+  void set_high_water_mark(size_t max_frames);
+
+  void get_statistics(struct vidio_frame_pool_statistics* out_stats) const;
+
+  // Delete all idle frames.
+  void clear();
+
+private:
+  using key = std::tuple<vidio_pixel_format, int, int, vidio_frame::plane_layout>;
+
+  mutable std::mutex m_mutex;
+
+  std::map<key, std::vector<vidio_frame*>> m_idle_frames;
+
+  size_t m_high_water_mark = cDefaultHighWaterMark;
+
+  uint64_t m_frames_allocated = 0;
+  uint64_t m_frames_reused = 0;
+  uint64_t m_frames_discarded = 0;
+  size_t m_frames_in_pool = 0;
+  size_t m_bytes_in_pool = 0;
+
+  static const size_t cDefaultHighWaterMark = 8;
+};
+
+#endif //LIBVIDIO_VIDIO_FRAME_POOL_H
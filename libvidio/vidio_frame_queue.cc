@@ -0,0 +1,397 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "vidio_frame_queue.h"
+#include "vidio_frame.h"
+#include <cassert>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+
+vidio_frame_queue::vidio_frame_queue(size_t max_frames)
+    : m_capacity(max_frames), m_slots(new std::atomic<const vidio_frame*>[max_frames]), m_max_frames(max_frames)
+{
+  assert(max_frames > 0);
+}
+
+
+vidio_frame_queue::~vidio_frame_queue()
+{
+  while (const vidio_frame* frame = pop()) {
+    delete frame;
+  }
+
+#if defined(__linux__)
+  if (m_event_fd >= 0) {
+    ::close(m_event_fd);
+  }
+#endif
+}
+
+
+void vidio_frame_queue::set_limits(size_t max_frames, size_t max_bytes)
+{
+  assert(max_frames > 0);
+
+  if (max_frames > m_capacity) {
+    // Move the queued frames into a larger ring. The producer is not running, so we are the only one accessing it.
+    std::unique_ptr<std::atomic<const vidio_frame*>[]> slots(new std::atomic<const vidio_frame*>[max_frames]);
+
+    size_t head = m_head.load(std::memory_order_acquire);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    for (size_t i = 0; i < tail - head; i++) {
+      slots[i].store(m_slots[(head + i) % m_capacity].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    m_slots = std::move(slots);
+    m_capacity = max_frames;
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(tail - head, std::memory_order_release);
+  }
+
+  m_max_frames = max_frames;
+  m_max_bytes = max_bytes;
+}
+
+
+bool vidio_frame_queue::is_full(size_t frame_size) const
+{
+  size_t num_frames = m_num_frames.load(std::memory_order_acquire);
+  if (num_frames >= m_max_frames) {
+    return true;
+  }
+
+  if (m_max_bytes != 0 && num_frames > 0 &&
+      m_num_bytes.load(std::memory_order_acquire) + frame_size > m_max_bytes) {
+    return true;
+  }
+
+  return false;
+}
+
+
+bool vidio_frame_queue::push(const vidio_frame* frame, std::vector<const vidio_frame*>& out_dropped)
+{
+  size_t frame_size = frame->get_memory_size();
+
+  if (m_delivery_mode == vidio_delivery_mode_latest_frame) {
+    push_into_mailbox(frame, frame_size, out_dropped);
+    return true;
+  }
+
+  while (is_full(frame_size)) {
+    switch (m_policy) {
+      case vidio_overflow_policy_drop_newest:
+        return false;
+
+      case vidio_overflow_policy_drop_oldest: {
+        // If the only queued frame is the one the consumer is currently working on, we cannot make room.
+        const vidio_frame* oldest = take_from_ring();
+        if (!oldest) {
+          return false;
+        }
+
+        account_removed_frame(oldest);
+        out_dropped.push_back(oldest);
+        break;
+      }
+
+      case vidio_overflow_policy_block: {
+        if (!m_producer_may_block) {
+          return false;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wait_mutex);
+
+        m_num_waiting_producers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        m_producer_cond.wait(lock, [this, frame_size]() {
+          return !is_full(frame_size) || m_producer_interrupted.load();
+        });
+
+        m_num_waiting_producers.fetch_sub(1, std::memory_order_relaxed);
+
+        if (m_producer_interrupted.load()) {
+          return false;
+        }
+        break;
+      }
+    }
+  }
+
+  m_num_frames.fetch_add(1, std::memory_order_acq_rel);
+  m_num_bytes.fetch_add(frame_size, std::memory_order_acq_rel);
+
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  m_slots[tail % m_capacity].store(frame, std::memory_order_relaxed);
+  m_tail.store(tail + 1, std::memory_order_release);
+
+  notify(m_num_waiting_consumers, m_wait_mutex, m_consumer_cond);
+  signal_event_fd();
+
+  return true;
+}
+
+
+void vidio_frame_queue::push_into_mailbox(const vidio_frame* frame, size_t frame_size,
+                                          std::vector<const vidio_frame*>& out_dropped)
+{
+  m_num_frames.fetch_add(1, std::memory_order_acq_rel);
+  m_num_bytes.fetch_add(frame_size, std::memory_order_acq_rel);
+
+  const vidio_frame* superseded = m_mailbox.exchange(frame, std::memory_order_acq_rel);
+  if (superseded) {
+    account_removed_frame(superseded);
+    m_num_superseded_frames.fetch_add(1, std::memory_order_relaxed);
+    out_dropped.push_back(superseded);
+  }
+
+  notify(m_num_waiting_consumers, m_wait_mutex, m_consumer_cond);
+  signal_event_fd();
+}
+
+
+void vidio_frame_queue::interrupt_producer()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_wait_mutex);
+    m_producer_interrupted = true;
+  }
+
+  m_producer_cond.notify_all();
+}
+
+
+void vidio_frame_queue::resume_producer()
+{
+  m_producer_interrupted = false;
+}
+
+
+const vidio_frame* vidio_frame_queue::take_from_ring() const
+{
+  size_t head = m_head.load(std::memory_order_acquire);
+
+  for (;;) {
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    if (head == tail) {
+      return nullptr;
+    }
+
+    // Only the producer writes the slots, and only after the head moved past them.
+    // If it did so in the meantime, the compare-exchange below fails and we read again.
+    const vidio_frame* frame = m_slots[head % m_capacity].load(std::memory_order_relaxed);
+
+    if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      return frame;
+    }
+  }
+}
+
+
+const vidio_frame* vidio_frame_queue::take_next_frame() const
+{
+  if (m_delivery_mode == vidio_delivery_mode_latest_frame) {
+    return m_mailbox.exchange(nullptr, std::memory_order_acq_rel);
+  }
+  else {
+    return take_from_ring();
+  }
+}
+
+
+void vidio_frame_queue::account_removed_frame(const vidio_frame* frame)
+{
+  m_num_bytes.fetch_sub(frame->get_memory_size(), std::memory_order_acq_rel);
+  m_num_frames.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+
+const vidio_frame* vidio_frame_queue::peek() const
+{
+  if (!m_claimed_frame) {
+    m_claimed_frame = take_next_frame();
+  }
+
+  return m_claimed_frame;
+}
+
+
+const vidio_frame* vidio_frame_queue::pop()
+{
+  const vidio_frame* frame = peek();
+  if (!frame) {
+    return nullptr;
+  }
+
+  m_claimed_frame = nullptr;
+  account_removed_frame(frame);
+
+  notify(m_num_waiting_producers, m_wait_mutex, m_producer_cond);
+
+  if (empty()) {
+    clear_event_fd();
+  }
+
+  return frame;
+}
+
+
+bool vidio_frame_queue::empty() const
+{
+  return m_claimed_frame == nullptr &&
+         m_mailbox.load(std::memory_order_acquire) == nullptr &&
+         m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+
+bool vidio_frame_queue::wait_for_frame(std::chrono::microseconds timeout)
+{
+  if (!empty()) {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(m_wait_mutex);
+
+  // Announce the waiter before checking the queue again. Together with the fence in notify(),
+  // either we see the new frame or the producer sees the waiter and notifies us.
+  m_num_waiting_consumers.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  auto frame_available_or_woken_up = [this]() { return !empty() || is_end_of_stream(); };
+
+  if (timeout.count() < 0) {
+    m_consumer_cond.wait(lock, frame_available_or_woken_up);
+  }
+  else {
+    m_consumer_cond.wait_for(lock, timeout, frame_available_or_woken_up);
+  }
+
+  m_num_waiting_consumers.fetch_sub(1, std::memory_order_relaxed);
+
+  return !empty();
+}
+
+
+void vidio_frame_queue::set_end_of_stream()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_wait_mutex);
+    m_end_of_stream.store(true, std::memory_order_release);
+  }
+
+  m_consumer_cond.notify_all();
+
+  // An event loop over several inputs has to see the end of stream even when no frame follows.
+  signal_event_fd();
+}
+
+
+void vidio_frame_queue::reset_end_of_stream()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_wait_mutex);
+    m_end_of_stream.store(false, std::memory_order_release);
+  }
+
+  // The event fd may still be readable because of the previous end of stream.
+  clear_event_fd();
+}
+
+
+int vidio_frame_queue::get_event_fd()
+{
+#if defined(__linux__)
+  std::lock_guard<std::mutex> lock(m_wait_mutex);
+
+  if (m_event_fd < 0) {
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) {
+      return -1;
+    }
+
+    m_event_fd = fd;
+
+    // Frames may already be waiting, or the stream has already ended.
+    if (!empty() || is_end_of_stream()) {
+      signal_event_fd();
+    }
+  }
+
+  return m_event_fd;
+#else
+  return -1;
+#endif
+}
+
+
+void vidio_frame_queue::signal_event_fd()
+{
+#if defined(__linux__)
+  int fd = m_event_fd.load(std::memory_order_acquire);
+  if (fd >= 0) {
+    uint64_t one = 1;
+    ssize_t n = ::write(fd, &one, sizeof(one));
+    (void) n; // can only fail if the counter overflows, which means that it is readable anyway
+  }
+#endif
+}
+
+
+void vidio_frame_queue::clear_event_fd()
+{
+#if defined(__linux__)
+  int fd = m_event_fd.load(std::memory_order_acquire);
+  if (fd < 0) {
+    return;
+  }
+
+  uint64_t value;
+  ssize_t n = ::read(fd, &value, sizeof(value));
+  (void) n; // EAGAIN if it was not signalled
+
+  // The producer may have pushed a frame after our emptiness check. Its signal could have been consumed by the read above.
+  // At the end of the stream, the fd stays readable.
+  if (!empty() || is_end_of_stream()) {
+    signal_event_fd();
+  }
+#endif
+}
+
+
+void vidio_frame_queue::notify(std::atomic<int>& num_waiting, std::mutex& mutex, std::condition_variable& cond)
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (num_waiting.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+
+  {
+    // Taking the lock makes sure that the waiter is either still before its check or already sleeping.
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+
+  cond.notify_all();
+}
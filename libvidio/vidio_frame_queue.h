@@ -0,0 +1,174 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVIDIO_VIDIO_FRAME_QUEUE_H
+#define LIBVIDIO_VIDIO_FRAME_QUEUE_H
+
+#include <libvidio/vidio.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+struct vidio_frame;
+
+
+// Bounded single-producer/single-consumer queue of captured frames.
+// push() is only called from the capturing thread, peek() and pop() only from the consumer.
+// Neither side takes a lock. A mutex is only used when one side actually has to sleep
+// (the consumer in wait_for_frame(), the producer with the 'block' overflow policy).
+//
+// In the 'latest_frame' delivery mode, the ring is not used. The producer replaces the frame in a single mailbox slot
+// and the consumer always receives the newest frame.
+//
+// The consumer claims the front frame when it peeks it. A claimed frame is not part of the ring anymore,
+// so that the producer can drop the oldest frames without pulling the peeked frame away from the consumer.
+class vidio_frame_queue
+{
+public:
+  explicit vidio_frame_queue(size_t max_frames);
+
+  // Deletes the frames remaining in the queue.
+  ~vidio_frame_queue();
+
+  // Only call this while the producer is not running.
+  // 'max_bytes' limits the plane memory held by the queued frames (0 = no limit). One frame is always accepted.
+  void set_limits(size_t max_frames, size_t max_bytes);
+
+  void set_overflow_policy(vidio_overflow_policy policy) { m_policy = policy; }
+
+  // Only call this while the producer is not running.
+  // A producer that must not block (a thread shared by several inputs) drops the new frame instead
+  // when the policy is 'block' and the queue is full.
+  void set_producer_may_block(bool may_block) { m_producer_may_block = may_block; }
+
+  // Only call this while the producer is not running and the queue is empty.
+  void set_delivery_mode(vidio_delivery_mode mode) { m_delivery_mode = mode; }
+
+  vidio_delivery_mode get_delivery_mode() const { return m_delivery_mode; }
+
+  // Number of frames that were replaced in the mailbox before the consumer took them.
+  uint64_t get_num_superseded_frames() const { return m_num_superseded_frames.load(std::memory_order_relaxed); }
+
+  // --- producer side
+
+  // Returns false if the frame was dropped. In that case, the frame is not taken over.
+  // Frames that were removed from the queue to make room for the new frame (policy 'drop_oldest', or
+  // the superseded frame in the 'latest_frame' mode) are appended to 'out_dropped' and have to be released by the caller.
+  bool push(const vidio_frame* frame, std::vector<const vidio_frame*>& out_dropped);
+
+  // Makes a push() that is blocked because of a full queue return (and drop the frame).
+  // All following pushes do not block either until resume_producer() is called.
+  void interrupt_producer();
+
+  void resume_producer();
+
+  // --- consumer side
+
+  // Returns nullptr if the queue is empty.
+  const vidio_frame* peek() const;
+
+  // Removes the front frame and hands it back to the caller. Returns nullptr if the queue is empty.
+  const vidio_frame* pop();
+
+  bool empty() const;
+
+  size_t size() const { return m_num_frames.load(std::memory_order_acquire); }
+
+  // Blocks until a frame is available, the timeout expired, or the end of stream is reached.
+  // A negative timeout waits without time limit. Returns whether a frame is available.
+  bool wait_for_frame(std::chrono::microseconds timeout);
+
+  // Marks the end of the stream and wakes up waiting consumers. The state is kept until reset_end_of_stream(),
+  // so that all following calls of wait_for_frame() return immediately once the queue is empty.
+  void set_end_of_stream();
+
+  void reset_end_of_stream();
+
+  bool is_end_of_stream() const { return m_end_of_stream.load(std::memory_order_acquire); }
+
+  // Returns an eventfd that is readable while the queue is not empty or the end of stream is set. It is created on the first call.
+  // Returns -1 if eventfds are not supported on this platform.
+  int get_event_fd();
+
+private:
+  size_t m_capacity;
+  std::unique_ptr<std::atomic<const vidio_frame*>[]> m_slots;
+
+  size_t m_max_frames;
+  size_t m_max_bytes = 0;
+  vidio_overflow_policy m_policy = vidio_overflow_policy_drop_newest;
+  bool m_producer_may_block = true;
+  vidio_delivery_mode m_delivery_mode = vidio_delivery_mode_queue;
+
+  // Both positions count up monotonically. The slot index is 'position % capacity'.
+  // The tail is only written by the producer. The head is advanced by the consumer, and by the producer
+  // when it drops the oldest frame. They are on separate cache lines so that producer and consumer do not
+  // invalidate each other's line.
+  alignas(64) mutable std::atomic<size_t> m_head{0};
+  alignas(64) std::atomic<size_t> m_tail{0};
+
+  // Frames and memory in the ring plus the claimed frame.
+  alignas(64) std::atomic<size_t> m_num_frames{0};
+  std::atomic<size_t> m_num_bytes{0};
+
+  // Single slot for the 'latest_frame' delivery mode.
+  alignas(64) mutable std::atomic<const vidio_frame*> m_mailbox{nullptr};
+  std::atomic<uint64_t> m_num_superseded_frames{0};
+
+  // The frame returned by peek(). Only accessed by the consumer.
+  mutable const vidio_frame* m_claimed_frame = nullptr;
+
+  // Only touched when one side has to sleep.
+  alignas(64) std::atomic<int> m_num_waiting_consumers{0};
+  std::atomic<int> m_num_waiting_producers{0};
+  std::atomic<bool> m_producer_interrupted{false};
+  std::mutex m_wait_mutex;
+  std::condition_variable m_consumer_cond;
+  std::condition_variable m_producer_cond;
+  std::atomic<bool> m_end_of_stream{false};  // only set with m_wait_mutex held
+
+  // -1 until get_event_fd() is called. The producer only writes to it if it exists.
+  std::atomic<int> m_event_fd{-1};
+
+  void signal_event_fd();
+
+  // Called by the consumer when it took the last frame.
+  void clear_event_fd();
+
+  bool is_full(size_t frame_size) const;
+
+  // Removes the oldest frame from the ring. Used by both sides.
+  const vidio_frame* take_from_ring() const;
+
+  const vidio_frame* take_next_frame() const;
+
+  void push_into_mailbox(const vidio_frame* frame, size_t frame_size, std::vector<const vidio_frame*>& out_dropped);
+
+  void account_removed_frame(const vidio_frame* frame);
+
+  static void notify(std::atomic<int>& num_waiting, std::mutex& mutex, std::condition_variable& cond);
+};
+
+#endif //LIBVIDIO_VIDIO_FRAME_QUEUE_H
@@ -19,7 +19,11 @@
  */
 
 #include <libvidio/vidio_input.h>
+#include <libvidio/vidio_frame.h>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 
 #if WITH_VIDEO4LINUX2
 #include "libvidio/v4l/vidio_input_device_v4l.h"
@@ -38,6 +42,201 @@
 #endif
 
 
+const vidio_frame* vidio_input::peek_next_frame() const
+{
+  return m_frame_queue.peek();
+}
+
+
+void vidio_input::pop_next_frame()
+{
+  get_frame_pool().release_frame(m_frame_queue.pop());
+}
+
+
+static std::atomic<bool> s_monotonic_timestamps{false};
+
+// Stream timestamps that deviate more than this from the dequeue time are anchored again (e.g. after a seek or pause).
+static const int64_t cMaxStreamClockDeviation_us = 1000000;
+
+
+void vidio_input::set_monotonic_timestamps(bool enable)
+{
+  s_monotonic_timestamps = enable;
+}
+
+
+uint64_t vidio_input::get_monotonic_time_us()
+{
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+
+void vidio_input::convert_timestamp_to_monotonic(vidio_frame* f)
+{
+  int64_t offset_us;
+
+  switch (f->get_clock_domain()) {
+    case vidio_clock_domain_monotonic:
+      return;
+
+    case vidio_clock_domain_realtime: {
+      auto realtime_now = std::chrono::system_clock::now().time_since_epoch();
+      offset_us = (int64_t) get_monotonic_time_us() - std::chrono::duration_cast<std::chrono::microseconds>(realtime_now).count();
+      break;
+    }
+
+    case vidio_clock_domain_stream: {
+      auto timestamp = (int64_t) f->get_timestamp_us();
+      auto dequeue_timestamp = (int64_t) f->get_dequeue_timestamp_us();
+
+      if (!m_stream_clock_anchored ||
+          std::abs(timestamp + m_stream_clock_offset_us - dequeue_timestamp) > cMaxStreamClockDeviation_us) {
+        m_stream_clock_offset_us = dequeue_timestamp - timestamp;
+        m_stream_clock_anchored = true;
+      }
+
+      offset_us = m_stream_clock_offset_us;
+      break;
+    }
+
+    default:
+      // Nothing is known about the clock. Leave the frame as it is.
+      return;
+  }
+
+  f->set_timestamp_us((uint64_t) ((int64_t) f->get_timestamp_us() + offset_us));
+  if (f->has_dts()) {
+    f->set_dts_us(f->get_dts_us() + offset_us);
+  }
+
+  f->set_clock_domain(vidio_clock_domain_monotonic);
+}
+
+
+void vidio_input::push_frame_into_queue(vidio_frame* f)
+{
+  if (f->get_dequeue_timestamp_us() == 0) {
+    f->set_dequeue_timestamp_us(get_monotonic_time_us());
+  }
+
+  if (s_monotonic_timestamps) {
+    convert_timestamp_to_monotonic(f);
+  }
+
+  std::vector<const vidio_frame*> dropped_frames;
+
+  bool queued = m_frame_queue.push(f, dropped_frames);
+
+  // Releasing the dropped frames is essential in zero-copy mode. It gives the capture buffers back to the driver.
+
+  if (!queued) {
+    dropped_frames.push_back(f);
+  }
+
+  for (auto* frame : dropped_frames) {
+    get_frame_pool().release_frame(frame);
+  }
+
+  // Superseded frames are the normal operation of the latest-frame mode. They are only counted.
+  if (!dropped_frames.empty() && m_frame_queue.get_delivery_mode() == vidio_delivery_mode_queue) {
+    m_queue_dropped_frames += dropped_frames.size();
+    send_callback_message(vidio_input_message_input_overflow);
+  }
+
+  if (queued) {
+    send_callback_message(vidio_input_message_new_frame);
+  }
+}
+
+
+void vidio_input::get_drop_statistics(struct vidio_input_drop_statistics* out_stats) const
+{
+  out_stats->driver_dropped_frames = m_driver_dropped_frames;
+  out_stats->queue_dropped_frames = m_queue_dropped_frames;
+}
+
+
+const vidio_error* vidio_input::set_queue_depth(int max_frames, size_t max_bytes)
+{
+  if (max_frames <= 0) {
+    auto* err = new vidio_error(vidio_error_code_parameter_error, "Invalid frame queue length ({0})");
+    err->set_arg(0, std::to_string(max_frames));
+    return err;
+  }
+
+  m_frame_queue.set_limits(static_cast<size_t>(max_frames), max_bytes);
+
+  return nullptr;
+}
+
+
+void vidio_input::set_delivery_mode(vidio_delivery_mode mode)
+{
+  // Frames left from a previous capture would not be found in the other mode.
+  clear_frame_queue();
+
+  m_frame_queue.set_delivery_mode(mode);
+}
+
+
+const vidio_error* vidio_input::reconfigure_capture(const vidio_video_format* requested_format,
+                                                   const vidio_video_format** out_actual_format)
+{
+  set_reconfigure_gap(-1, -1);
+
+  const vidio_error* err = stop_capturing();
+  if (err) {
+    return err;
+  }
+
+  err = set_capture_format(requested_format, out_actual_format);
+  if (err) {
+    return err;
+  }
+
+  return start_capturing();
+}
+
+
+bool vidio_input::get_reconfigure_gap(int64_t* out_gap_us, int* out_missed_frames) const
+{
+  std::lock_guard<std::mutex> lock(m_reconfigure_gap_mutex);
+
+  if (m_reconfigure_gap_us < 0) {
+    return false;
+  }
+
+  if (out_gap_us) {
+    *out_gap_us = m_reconfigure_gap_us;
+  }
+
+  if (out_missed_frames) {
+    *out_missed_frames = m_reconfigure_missed_frames;
+  }
+
+  return true;
+}
+
+
+void vidio_input::set_reconfigure_gap(int64_t gap_us, int missed_frames)
+{
+  std::lock_guard<std::mutex> lock(m_reconfigure_gap_mutex);
+
+  m_reconfigure_gap_us = gap_us;
+  m_reconfigure_missed_frames = missed_frames;
+}
+
+
+void vidio_input::clear_frame_queue()
+{
+  while (const vidio_frame* frame = m_frame_queue.pop()) {
+    get_frame_pool().release_frame(frame);
+  }
+}
+
+
 vidio_input* vidio_input::find_matching_device(const std::vector<vidio_input*>& inputs, const std::string& serializedString,
                                                vidio_serialization_format serialformat)
 {
@@ -24,7 +24,11 @@
 #include <libvidio/vidio.h>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <atomic>
 #include "vidio_error.h"
+#include "vidio_frame_pool.h"
+#include "vidio_frame_queue.h"
 
 
 struct vidio_input
@@ -51,26 +55,96 @@ public:
 
   virtual const vidio_error* stop_capturing() = 0;
 
-  virtual const vidio_frame* peek_next_frame() const = 0;
+  // Switches to a different capture format while capturing. This implementation simply restarts capturing.
+  virtual const vidio_error* reconfigure_capture(const vidio_video_format* requested_format,
+                                                 const vidio_video_format** out_actual_format);
 
-  virtual void pop_next_frame() = 0;
+  // Interruption of the frame stream caused by the last reconfigure_capture(). Returns false while it is not known.
+  bool get_reconfigure_gap(int64_t* out_gap_us, int* out_missed_frames) const;
+
+  // Called from the capturing thread when the first frame after reconfigure_capture() has been captured.
+  void set_reconfigure_gap(int64_t gap_us, int missed_frames);
+
+  virtual const vidio_frame* peek_next_frame() const;
+
+  virtual void pop_next_frame();
+
+  bool wait_for_frame(int64_t timeout_us) { return m_frame_queue.wait_for_frame(std::chrono::microseconds(timeout_us)); }
+
+  int get_event_fd() { return m_frame_queue.get_event_fd(); }
+
+  // The stream ended and all frames have been taken from the queue.
+  bool is_end_of_stream() const { return m_frame_queue.is_end_of_stream() && m_frame_queue.empty(); }
+
+  // Called from the capturing thread. What happens when the queue is full depends on the overflow policy.
+  // Sets the dequeue timestamp if the input did not set it, and converts the timestamps to CLOCK_MONOTONIC if requested.
+  void push_frame_into_queue(vidio_frame* f);
+
+  // Library-wide, see vidio_set_monotonic_timestamps().
+  static void set_monotonic_timestamps(bool enable);
+
+  static uint64_t get_monotonic_time_us();
+
+  // Only call these while not capturing.
+  const vidio_error* set_queue_depth(int max_frames, size_t max_bytes);
+
+  void set_overflow_policy(vidio_overflow_policy policy) { m_frame_queue.set_overflow_policy(policy); }
+
+  void set_delivery_mode(vidio_delivery_mode mode);
+
+  uint64_t get_superseded_frame_count() const { return m_frame_queue.get_num_superseded_frames(); }
+
+  // Called from the capturing thread when the driver reports that it skipped frames.
+  void add_driver_dropped_frames(uint64_t n) { m_driver_dropped_frames += n; }
+
+  void get_drop_statistics(struct vidio_input_drop_statistics* out_stats) const;
 
   virtual std::string serialize(vidio_serialization_format serialformat) const { return {}; }
 
   static vidio_input* find_matching_device(const std::vector<vidio_input*>& inputs, const std::string& serialData, vidio_serialization_format serialformat);
 
+  // Popped frames are returned to this pool and reused for the next captured frames.
+  vidio_frame_pool& get_frame_pool() const { return m_frame_pool; }
+
 private:
+  mutable vidio_frame_pool m_frame_pool;
+
   void (* m_message_callback)(enum vidio_input_message, void* userData) = nullptr;
 
   void* m_user_data;
 
+  std::atomic<uint64_t> m_driver_dropped_frames{0};
+  std::atomic<uint64_t> m_queue_dropped_frames{0};
+
+  // Conversion of stream timestamps to CLOCK_MONOTONIC. Only accessed from the capturing thread.
+  bool m_stream_clock_anchored = false;
+  int64_t m_stream_clock_offset_us = 0;  // monotonic time minus stream time
+
+  void convert_timestamp_to_monotonic(vidio_frame* f);
+
+  mutable std::mutex m_reconfigure_gap_mutex;
+  int64_t m_reconfigure_gap_us = -1;
+  int m_reconfigure_missed_frames = -1;
+
 protected:
-  void send_callback_message(enum vidio_input_message msg) const
+  void send_callback_message(enum vidio_input_message msg)
   {
+    if (msg == vidio_input_message_end_of_stream) {
+      // Let wait_for_frame() return, now and in all following calls until capturing is restarted.
+      m_frame_queue.set_end_of_stream();
+    }
+
     if (m_message_callback) {
       m_message_callback(msg, m_user_data);
     }
   }
+
+  // Only call this while the capturing thread is not running.
+  void clear_frame_queue();
+
+  static const int cDefaultFrameQueueLength = 20;
+
+  vidio_frame_queue m_frame_queue{cDefaultFrameQueueLength};
 };
 
 
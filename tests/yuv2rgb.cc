@@ -0,0 +1,172 @@
+/*
+ * VidIO library
+ * Copyright (c) 2024 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libvidio.
+ *
+ * libvidio is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Checks the YUV to RGB row kernels:
+// - each SIMD code path supported by the CPU (not only the dispatched one) gives exactly the same results
+//   as the scalar reference yuv_pixel_to_rgb8(),
+// - the fixed-point reference deviates by at most one level from the former floating-point conversion.
+
+#include "libvidio/colorconversion/yuv2rgb.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+static const int cMaxWidth = 200;
+
+static int s_num_failures = 0;
+
+
+static void report_mismatch(const char* function, const yuv2rgb_kernels& kernels,
+                            vidio_color_matrix matrix, vidio_color_range range, int width, int x)
+{
+  if (s_num_failures < 20) {
+    fprintf(stderr, "%s (%s): mismatch at x=%d (width=%d, matrix=%d, range=%d)\n",
+            function, kernels.name, x, width, (int) matrix, (int) range);
+  }
+
+  s_num_failures++;
+}
+
+
+static void test_yuyv_kernel(std::mt19937& rng, const yuv2rgb_kernels& kernels,
+                             vidio_color_matrix matrix, vidio_color_range range)
+{
+  const auto& coeffs = get_yuv2rgb_coefficients(matrix, range);
+  std::uniform_int_distribution<int> sample(0, 255);
+
+  for (int width = 1; width <= cMaxWidth; width++) {
+    std::vector<uint8_t> yuyv(2 * width);
+    for (auto& v : yuyv) {
+      v = (uint8_t) sample(rng);
+    }
+
+    std::vector<uint8_t> rgb(3 * width);
+    yuyv_row_to_rgb8(yuyv.data(), rgb.data(), width, coeffs, kernels);
+
+    for (int x = 0; x < width; x++) {
+      int pair = x & ~1;
+      int u = yuyv[2 * pair + 1];
+      int v = (pair + 1 < width) ? yuyv[2 * pair + 3] : (pair > 0 ? yuyv[2 * pair - 1] : 128);
+
+      uint8_t expected[3];
+      yuv_pixel_to_rgb8(yuyv[2 * x], u, v, expected, coeffs);
+
+      if (rgb[3 * x] != expected[0] || rgb[3 * x + 1] != expected[1] || rgb[3 * x + 2] != expected[2]) {
+        report_mismatch("yuyv_row_to_rgb8", kernels, matrix, range, width, x);
+        break;
+      }
+    }
+  }
+}
+
+
+static void test_planar_kernel(std::mt19937& rng, const yuv2rgb_kernels& kernels,
+                               vidio_color_matrix matrix, vidio_color_range range)
+{
+  const auto& coeffs = get_yuv2rgb_coefficients(matrix, range);
+  std::uniform_int_distribution<int> sample(0, 255);
+
+  for (int width = 1; width <= cMaxWidth; width++) {
+    int chroma_width = (width + 1) / 2;
+
+    std::vector<uint8_t> y(width), u(chroma_width), v(chroma_width);
+    for (auto* plane : {&y, &u, &v}) {
+      for (auto& s : *plane) {
+        s = (uint8_t) sample(rng);
+      }
+    }
+
+    std::vector<uint8_t> rgb(3 * width);
+    yuv_planar_row_to_rgb8(y.data(), u.data(), v.data(), rgb.data(), width, coeffs, kernels);
+
+    for (int x = 0; x < width; x++) {
+      uint8_t expected[3];
+      yuv_pixel_to_rgb8(y[x], u[x / 2], v[x / 2], expected, coeffs);
+
+      if (rgb[3 * x] != expected[0] || rgb[3 * x + 1] != expected[1] || rgb[3 * x + 2] != expected[2]) {
+        report_mismatch("yuv_planar_row_to_rgb8", kernels, matrix, range, width, x);
+        break;
+      }
+    }
+  }
+}
+
+
+// The floating-point BT.601 limited range conversion used before the fixed-point kernels
+// (with the red coefficient corrected from 1.1596 to 1.596).
+static void test_against_floating_point()
+{
+  const auto& coeffs = get_yuv2rgb_coefficients(vidio_color_matrix_bt601, vidio_color_range_limited);
+
+  for (int y = 0; y < 256; y++)
+    for (int u = 0; u < 256; u++)
+      for (int v = 0; v < 256; v++) {
+        int c = y - 16;
+        int d = u - 128;
+        int e = v - 128;
+
+        int expected[3] = {clip8(1.164 * c + 1.596 * e),
+                           clip8(1.164 * c - 0.392 * d - 0.813 * e),
+                           clip8(1.164 * c + 2.017 * d)};
+
+        uint8_t rgb[3];
+        yuv_pixel_to_rgb8(y, u, v, rgb, coeffs);
+
+        for (int i = 0; i < 3; i++) {
+          if (abs(rgb[i] - expected[i]) > 1) {
+            if (s_num_failures < 20) {
+              fprintf(stderr, "yuv_pixel_to_rgb8: YUV=(%d,%d,%d) component %d is %d, floating point gives %d\n",
+                      y, u, v, i, rgb[i], expected[i]);
+            }
+
+            s_num_failures++;
+          }
+        }
+      }
+}
+
+
+int main()
+{
+  for (const auto& kernels : get_available_yuv2rgb_kernels()) {
+    printf("testing %s kernels\n", kernels.name);
+
+    // Same input data for each kernel set.
+    std::mt19937 rng(1);
+
+    for (auto matrix : {vidio_color_matrix_bt601, vidio_color_matrix_bt709, vidio_color_matrix_bt2020}) {
+      for (auto range : {vidio_color_range_limited, vidio_color_range_full}) {
+        test_yuyv_kernel(rng, kernels, matrix, range);
+        test_planar_kernel(rng, kernels, matrix, range);
+      }
+    }
+  }
+
+  test_against_floating_point();
+
+  if (s_num_failures) {
+    fprintf(stderr, "%d failures\n", s_num_failures);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}